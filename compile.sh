@@ -1 +1 @@
-g++ -Iinclude include/*.cpp main.cpp -o stt -std=c++11 $1 $2 $3 $4
+g++ -Iinclude include/*.cpp main.cpp -o stt -std=c++11 -fopenmp $1 $2 $3 $4
@@ -0,0 +1,416 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given 1D system, assumed to be a spin valve/tunnel
+//  junction.
+//
+//  File: amr.cpp <CODE>
+//
+//  Block-structured adaptive mesh refinement for evolve.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+// Standard libraries
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "amr.hpp"
+#include "physics.hpp"
+
+namespace amr {
+  // Length of a 3-vector
+  double norm(const solver::vec_t<double>& v) {
+    return std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+  }
+
+  // Limited slope, zero at extrema
+  double minmod(double a, double b) {
+    if (a*b <= 0.0) return 0.0;
+    return (std::abs(a) < std::abs(b)) ? a : b;
+  }
+
+  hierarchy_t::hierarchy_t(const std::vector<double>& x,
+                           const std::vector<double>& h,
+                           const std::vector<std::vector<double> >& mag,
+                           const std::vector<std::vector<double> >& scal_prop,
+                           int max_level,
+                           double tol_grad,
+                           double tol_div,
+                           int buffer,
+                           const physics::scheme_t& scheme)
+    : x_base(x), h_base(h), max_level(max_level), buffer(buffer), tol_grad(tol_grad), tol_div(tol_div), scheme(scheme) {
+    int n = x.size();
+    iface_at.assign(n, -1);
+    for (int i=0; i<scheme.iface.size(); i++) iface_at[scheme.iface[i].face] = i;
+    c.resize(n);
+    r.resize(n);
+    j_p.resize(n);
+    m_eq.resize(n);
+    for (int i=0; i<n; i++) {
+      c[i] = physics::diff_tensor(mag[i], scal_prop[1][i], scal_prop[2][i], scal_prop[3][i]);
+      r[i] = physics::relax_tensor(mag[i], scal_prop[4][i], scal_prop[5][i], scal_prop[6][i]);
+      for (int l=0; l<3; l++) {
+        j_p[i][l] = scal_prop[1][i]*mag[i][l];
+        m_eq[i][l] = scal_prop[0][i]*mag[i][l];
+      }
+    }
+
+    set(std::vector<std::vector<double> >(n, std::vector<double>(3, 0.0)));
+  }
+
+  // Set dm on the base level, removing all refinement
+  void hierarchy_t::set(const std::vector<std::vector<double> >& dm) {
+    patch_t p;
+    p.first = 0;
+    p.last = x_base.size()-1;
+    build(0, p, std::vector<patch_t>());
+    for (int k=0; k<p.dm.size(); k++) {
+      for (int l=0; l<3; l++) p.dm[k][l] = dm[k][l];
+    }
+    grid.assign(1, std::vector<patch_t>(1, p));
+  }
+
+  // Patch of level lev-1 containing a base cell, -1 if none
+  int hierarchy_t::parent(int lev, int base) const {
+    const std::vector<patch_t>& coarse = grid[lev-1];
+    for (int i=0; i<coarse.size(); i++) {
+      if (base >= coarse[i].first && base <= coarse[i].last) return i;
+    }
+    return -1;
+  }
+
+  // Cells of a patch, dm copied from the old patches of the level where they
+  // overlap and interpolated from the (already rebuilt) parent level elsewhere
+  void hierarchy_t::build(int lev, patch_t& p, const std::vector<patch_t>& old) const {
+    int ratio = 1 << lev;
+    int n = (p.last-p.first+1)*ratio;
+    p.x.resize(n);
+    p.h.resize(n);
+    p.base.resize(n);
+    p.dm.resize(n);
+    p.flux.resize(n+1);
+    for (int k=0; k<=n; k++) p.flux[k].fill(0.0);
+    p.flux_left.fill(0.0);
+    p.flux_right.fill(0.0);
+
+    for (int b=p.first; b<=p.last; b++) {
+      // Old patch at this level covering b
+      int o = -1;
+      for (int i=0; i<old.size(); i++) {
+        if (b >= old[i].first && b <= old[i].last) o = i;
+      }
+
+      for (int s=0; s<ratio; s++) {
+        int k = ((b-p.first)*ratio)+s;
+        p.base[k] = b;
+        p.h[k] = h_base[b]/ratio;
+        p.x[k] = x_base[b]-(0.5*h_base[b])+((s+0.5)*p.h[k]);
+
+        if (o >= 0) {
+          p.dm[k] = old[o].dm[((b-old[o].first)*ratio)+s];
+        }
+        else if (lev == 0) {
+          p.dm[k].fill(0.0);
+        }
+        // Limited linear interpolation from the parent cell, conserves dm
+        else {
+          const patch_t& pp = grid[lev-1][parent(lev, b)];
+          int kc = ((b-pp.first)*(ratio/2))+(s/2);
+          for (int l=0; l<3; l++) {
+            double left = (kc > 0) ? (pp.dm[kc][l]-pp.dm[kc-1][l])/(pp.x[kc]-pp.x[kc-1]) : 0.0;
+            double right = (kc+1 < pp.dm.size()) ? (pp.dm[kc+1][l]-pp.dm[kc][l])/(pp.x[kc+1]-pp.x[kc]) : 0.0;
+            p.dm[k][l] = pp.dm[kc][l]+(minmod(left, right)*(p.x[k]-pp.x[kc]));
+          }
+        }
+      }
+    }
+    p.dm_old = p.dm;
+  }
+
+  // Ghost cell beyond one edge of a patch, interpolated linearly in space between the
+  // parent cells either side of the edge and in time between the parent's old and new dm
+  void hierarchy_t::ghost(int lev, const patch_t& p, bool left, double alpha, solver::vec_t<double>& dm_g, double& x_g) const {
+    const patch_t& pp = grid[lev-1][parent(lev, p.first)];
+    int ratio = 1 << (lev-1);
+
+    int out, in;
+    double h_g;
+    if (left) {
+      in = (p.first-pp.first)*ratio;
+      out = in-1;
+      h_g = h_base[p.first-1]/(2*ratio);
+      x_g = p.x.front()-(0.5*p.h.front())-(0.5*h_g);
+    }
+    else {
+      in = ((p.last+1-pp.first)*ratio)-1;
+      out = in+1;
+      h_g = h_base[p.last+1]/(2*ratio);
+      x_g = p.x.back()+(0.5*p.h.back())+(0.5*h_g);
+    }
+
+    double t = (x_g-pp.x[out])/(pp.x[in]-pp.x[out]);
+    for (int l=0; l<3; l++) {
+      double v_out = ((1.0-alpha)*pp.dm_old[out][l])+(alpha*pp.dm[out][l]);
+      double v_in = ((1.0-alpha)*pp.dm_old[in][l])+(alpha*pp.dm[in][l]);
+      dm_g[l] = v_out+(t*(v_in-v_out));
+    }
+  }
+
+  // Spin current through the face between cells of base cells b_l and b_r
+  solver::vec_t<double> hierarchy_t::face_flux(int b_l, int b_r, double x_l, double x_r, double h_l, double h_r,
+                                               const solver::vec_t<double>& dm_l, const solver::vec_t<double>& dm_r, double j_e) const {
+    solver::block_t<double> g, w_l, w_r;
+    if (b_r == b_l+1 && iface_at[b_l] >= 0) {
+      physics::iface_coeff(c[b_l], c[b_r], h_l, h_r, scheme.iface[iface_at[b_l]].g, g, w_l, w_r);
+    }
+    else {
+      physics::face_coeff(c[b_l], c[b_r], h_l, h_r, x_r-x_l, scheme.harmonic, g, w_l, w_r);
+    }
+    solver::vec_t<double> f_l = solver::mul(w_l, j_p[b_l]);
+    solver::vec_t<double> f_r = solver::mul(w_r, j_p[b_r]);
+    solver::vec_t<double> diff = solver::mul(g, solver::sub(dm_r, dm_l));
+    solver::vec_t<double> flux;
+    for (int l=0; l<3; l++) flux[l] = (j_e*(f_l[l]+f_r[l]))-diff[l];
+    return flux;
+  }
+
+  // Face spin current J_m = B*j_e*M - C*d(dm)/dx
+  void hierarchy_t::fluxes(int lev, patch_t& p, double j_e, double alpha) {
+    int n = p.dm.size();
+    int ratio = 1 << lev;
+
+    // Interior faces
+    for (int k=1; k<n; k++) {
+      p.flux[k] = face_flux(p.base[k-1], p.base[k], p.x[k-1], p.x[k], p.h[k-1], p.h[k], p.dm[k-1], p.dm[k], j_e);
+    }
+
+    // Left edge, the outer boundary condition at the end of the system
+    int b = p.base.front();
+    if (p.first == 0) {
+      double src = (scheme.bc_left == physics::bc_zero_flux) ? 0.0 : j_e;
+      solver::block_t<double> g = physics::boundary_coeff(c[b], p.h.front(), scheme.bc_left, scheme.lead_left);
+      solver::vec_t<double> grad = solver::mul(g, p.dm.front());
+      for (int l=0; l<3; l++) p.flux[0][l] = (src*j_p[b][l])-grad[l];
+    }
+    else {
+      solver::vec_t<double> dm_g;
+      double x_g;
+      ghost(lev, p, true, alpha, dm_g, x_g);
+      int bg = p.first-1;
+      p.flux[0] = face_flux(bg, b, x_g, p.x.front(), h_base[bg]/ratio, p.h.front(), dm_g, p.dm.front(), j_e);
+    }
+
+    // Right edge
+    b = p.base.back();
+    if (p.last == x_base.size()-1) {
+      double src = (scheme.bc_right == physics::bc_zero_flux) ? 0.0 : j_e;
+      solver::block_t<double> g = physics::boundary_coeff(c[b], p.h.back(), scheme.bc_right, scheme.lead_right);
+      solver::vec_t<double> grad = solver::mul(g, p.dm.back());
+      for (int l=0; l<3; l++) p.flux[n][l] = (src*j_p[b][l])+grad[l];
+    }
+    else {
+      solver::vec_t<double> dm_g;
+      double x_g;
+      ghost(lev, p, false, alpha, dm_g, x_g);
+      int bg = p.last+1;
+      p.flux[n] = face_flux(b, bg, p.x.back(), x_g, p.h.back(), h_base[bg]/ratio, p.dm.back(), dm_g, j_e);
+    }
+  }
+
+  // Explicit step of a level at time alpha through its parent's step,
+  // followed by four substeps of the next level
+  void hierarchy_t::advance(int lev, double dt, double j_e, double alpha) {
+    for (int i=0; i<grid[lev].size(); i++) {
+      patch_t& p = grid[lev][i];
+      p.dm_old = p.dm;
+      fluxes(lev, p, j_e, alpha);
+
+      // d(dm)/dt = -d(J_m)/dx + R*dm
+      for (int k=0; k<p.dm.size(); k++) {
+        solver::vec_t<double> relax = solver::mul(r[p.base[k]], p.dm_old[k]);
+        for (int l=0; l<3; l++) {
+          p.dm[k][l] += dt*(((p.flux[k][l]-p.flux[k+1][l])/p.h[k])+relax[l]);
+        }
+      }
+
+      for (int l=0; l<3; l++) {
+        p.flux_left[l] += dt*p.flux.front()[l];
+        p.flux_right[l] += dt*p.flux.back()[l];
+      }
+    }
+
+    if (lev+1 < grid.size()) {
+      for (int i=0; i<grid[lev+1].size(); i++) {
+        grid[lev+1][i].flux_left.fill(0.0);
+        grid[lev+1][i].flux_right.fill(0.0);
+      }
+      for (int s=0; s<4; s++) advance(lev+1, 0.25*dt, j_e, 0.25*s);
+
+      restrict_level(lev+1);
+      reflux(lev, dt);
+    }
+  }
+
+  // Replace the parent cells under each patch of a level by the fine average
+  void hierarchy_t::restrict_level(int lev) {
+    int ratio = 1 << (lev-1);
+    for (int i=0; i<grid[lev].size(); i++) {
+      const patch_t& q = grid[lev][i];
+      patch_t& pp = grid[lev-1][parent(lev, q.first)];
+      int first = (q.first-pp.first)*ratio;
+
+      for (int k=0; k<q.dm.size()/2; k++) pp.dm[first+k].fill(0.0);
+      for (int k=0; k<q.dm.size(); k++) {
+        int kc = first+(k/2);
+        for (int l=0; l<3; l++) pp.dm[kc][l] += q.h[k]*q.dm[k][l]/pp.h[kc];
+      }
+    }
+  }
+
+  // Correct the cells of a level next to its child patches so the flux through the
+  // shared faces is the accumulated fine flux
+  void hierarchy_t::reflux(int lev, double dt) {
+    int ratio = 1 << lev;
+    for (int i=0; i<grid[lev+1].size(); i++) {
+      const patch_t& q = grid[lev+1][i];
+      patch_t& pp = grid[lev][parent(lev+1, q.first)];
+
+      if (q.first > 0) {
+        int face = (q.first-pp.first)*ratio;
+        int kc = face-1;
+        for (int l=0; l<3; l++) pp.dm[kc][l] += ((dt*pp.flux[face][l])-q.flux_left[l])/pp.h[kc];
+      }
+      if (q.last < x_base.size()-1) {
+        int face = (q.last+1-pp.first)*ratio;
+        int kc = face;
+        for (int l=0; l<3; l++) pp.dm[kc][l] += (q.flux_right[l]-(dt*pp.flux[face][l]))/pp.h[kc];
+      }
+    }
+  }
+
+  // Advance all levels by the base step dt at current j_e
+  void hierarchy_t::step(double dt, double j_e) {
+    advance(0, dt, j_e, 0.0);
+  }
+
+  // Rebuild the refined levels from the current solution
+  void hierarchy_t::regrid() {
+    int n = x_base.size();
+    std::vector<std::vector<bool> > flag(max_level+1, std::vector<bool>(n, false));
+
+    // Flag the base cells of level lev+1 from the data of level lev
+    for (int lev=0; lev<std::min(max_level, levels()); lev++) {
+      for (int i=0; i<grid[lev].size(); i++) {
+        const patch_t& p = grid[lev][i];
+        for (int k=0; k<p.dm.size(); k++) {
+          if (tol_grad > 0.0 && k+1 < p.dm.size() &&
+              norm(solver::sub(p.dm[k+1], p.dm[k]))/(p.x[k+1]-p.x[k]) > tol_grad) {
+            flag[lev+1][p.base[k]] = true;
+            flag[lev+1][p.base[k+1]] = true;
+          }
+          if (tol_div > 0.0 && norm(solver::sub(p.flux[k+1], p.flux[k]))/p.h[k] > tol_div) {
+            flag[lev+1][p.base[k]] = true;
+          }
+        }
+      }
+    }
+
+    // Buffer, then nest each level inside its parent with one base cell to spare
+    for (int lev=max_level; lev>0; lev--) {
+      int pad = buffer;
+      if (lev < max_level) {
+        for (int b=0; b<n; b++) {
+          if (!flag[lev+1][b]) continue;
+          for (int d=-1; d<=1; d++) {
+            if (b+d >= 0 && b+d < n) flag[lev][b+d] = true;
+          }
+        }
+      }
+      std::vector<bool> padded = flag[lev];
+      for (int b=0; b<n; b++) {
+        if (!flag[lev][b]) continue;
+        for (int d=-pad; d<=pad; d++) {
+          if (b+d >= 0 && b+d < n) padded[b+d] = true;
+        }
+      }
+      flag[lev] = padded;
+    }
+
+    // Rebuild from the top, new cells interpolated from the rebuilt parent
+    std::vector<std::vector<patch_t> > old = grid;
+    grid.resize(1);
+    for (int lev=1; lev<=max_level; lev++) {
+      std::vector<patch_t> patches;
+      int b = 0;
+      while (b < n) {
+        if (!flag[lev][b]) {b++; continue;}
+        patch_t p;
+        p.first = b;
+        while (b < n && flag[lev][b]) b++;
+        p.last = b-1;
+        patches.push_back(p);
+      }
+      if (patches.empty()) break;
+
+      grid.push_back(std::vector<patch_t>());
+      const std::vector<patch_t>& old_lev = (lev < old.size()) ? old[lev] : std::vector<patch_t>();
+      for (int i=0; i<patches.size(); i++) build(lev, patches[i], old_lev);
+      grid[lev] = patches;
+    }
+  }
+
+  // Finest cells covering the system with their spin accumulation and current
+  void hierarchy_t::leaves(std::vector<double>& x,
+                           std::vector<std::vector<double> >& m,
+                           std::vector<std::vector<double> >& j_m) const {
+    x.clear();
+    m.clear();
+    j_m.clear();
+
+    for (int b=0; b<x_base.size(); b++) {
+      // Deepest patch covering b
+      int lev = levels()-1;
+      int i = -1;
+      for (; lev>=0; lev--) {
+        for (int j=0; j<grid[lev].size(); j++) {
+          if (b >= grid[lev][j].first && b <= grid[lev][j].last) i = j;
+        }
+        if (i >= 0) break;
+      }
+      const patch_t& p = grid[lev][i];
+      int ratio = 1 << lev;
+      for (int s=0; s<ratio; s++) {
+        int k = ((b-p.first)*ratio)+s;
+        x.push_back(p.x[k]);
+        m.push_back(std::vector<double>(3));
+        j_m.push_back(std::vector<double>(3));
+        for (int l=0; l<3; l++) {
+          m.back()[l] = p.dm[k][l]+m_eq[b][l];
+          j_m.back()[l] = 0.5*(p.flux[k][l]+p.flux[k+1][l]);
+        }
+      }
+    }
+  }
+
+  // Base level dm, the average of any refined cells
+  void hierarchy_t::base(std::vector<std::vector<double> >& dm) const {
+    const patch_t& p = grid[0][0];
+    dm.assign(p.dm.size(), std::vector<double>(3));
+    for (int k=0; k<p.dm.size(); k++) {
+      for (int l=0; l<3; l++) dm[k][l] = p.dm[k][l];
+    }
+  }
+
+  int hierarchy_t::cells() const {
+    int n = 0;
+    for (int lev=0; lev<levels(); lev++) {
+      for (int i=0; i<grid[lev].size(); i++) n += grid[lev][i].dm.size();
+    }
+    return n;
+  }
+}
@@ -0,0 +1,123 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given 1D system, assumed to be a spin valve/tunnel
+//  junction.
+//
+//  File: amr.hpp <HEADER>
+//
+//  Block-structured adaptive mesh refinement for evolve.
+//
+//  Level 0 is the system grid. Level l splits each base
+//  cell it covers into 2^l cells and is made of patches,
+//  runs of base cells, nested inside level l-1 with at
+//  least one base cell of coarse data either side unless
+//  they reach the end of the system. Each level takes
+//  four explicit steps per step of its parent (diffusion
+//  needs dt ~ h^2), with ghost cells interpolated in
+//  space and time from the parent. After the fine steps
+//  the parent cells under a patch are replaced by the
+//  fine average and the parent cells next to it are
+//  corrected by the difference between the coarse and
+//  the accumulated fine face fluxes (refluxing), so
+//  spin is conserved across the levels.
+//
+//  Face fluxes use the same face coefficients as phys-
+//  ics::assemble (arithmetic or harmonic means, in se-
+//  ries with any interface conductance) and the same
+//  outer boundary conditions.
+//
+//  Cells are flagged where |grad dm| or |div J_m| exceed
+//  a threshold. Regridding rebuilds every level from the
+//  flags, so smooth regions are coarsened again.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+#ifndef AMR_HPP
+#define AMR_HPP
+
+#include <vector>
+
+#include "solver.hpp"
+#include "physics.hpp"
+
+namespace amr {
+  // Cells of one patch, base cells [first, last] split 2^level times
+  struct patch_t {
+    int first, last;
+
+    std::vector<double> x;                             // Cell centres
+    std::vector<double> h;                             // Cell widths
+    std::vector<int> base;                             // Base cell of each cell
+    std::vector<solver::vec_t<double> > dm;            // m - m_inf*M
+    std::vector<solver::vec_t<double> > dm_old;        // dm at the start of the step
+    std::vector<solver::vec_t<double> > flux;          // Face spin current, n+1 faces
+    solver::vec_t<double> flux_left, flux_right;       // Time integrated edge fluxes over the parent step
+  };
+
+  class hierarchy_t {
+  public:
+    // Base cells and their properties, scal_prop is indexed as in system_t
+    hierarchy_t(const std::vector<double>& x,
+                const std::vector<double>& h,
+                const std::vector<std::vector<double> >& mag,
+                const std::vector<std::vector<double> >& scal_prop,
+                int max_level,
+                double tol_grad,
+                double tol_div,
+                int buffer,
+                const physics::scheme_t& scheme = physics::scheme_t());
+
+    // Set dm on the base level, removing all refinement
+    void set(const std::vector<std::vector<double> >& dm);
+
+    // Advance all levels by the base step dt at current j_e
+    void step(double dt, double j_e);
+
+    // Rebuild the refined levels from the current solution
+    void regrid();
+
+    // Finest cells covering the system with their spin accumulation and current
+    void leaves(std::vector<double>& x,
+                std::vector<std::vector<double> >& m,
+                std::vector<std::vector<double> >& j_m) const;
+
+    // Base level dm, the average of any refined cells
+    void base(std::vector<std::vector<double> >& dm) const;
+
+    int levels() const {return grid.size();}
+    int cells() const;
+
+  private:
+    void advance(int lev, double dt, double j_e, double alpha);
+    void fluxes(int lev, patch_t& p, double j_e, double alpha);
+    solver::vec_t<double> face_flux(int b_l, int b_r, double x_l, double x_r, double h_l, double h_r,
+                                    const solver::vec_t<double>& dm_l, const solver::vec_t<double>& dm_r, double j_e) const;
+    void ghost(int lev, const patch_t& p, bool left, double alpha, solver::vec_t<double>& dm_g, double& x_g) const;
+    void restrict_level(int lev);
+    void reflux(int lev, double dt);
+    int parent(int lev, int base) const;
+    void build(int lev, patch_t& p, const std::vector<patch_t>& old) const;
+
+    // Base cell tensors, diffusion C, relaxation R, source B*M and equilibrium m_inf*M
+    std::vector<solver::block_t<double> > c, r;
+    std::vector<solver::vec_t<double> > j_p, m_eq;
+    std::vector<double> x_base, h_base;
+
+    int max_level, buffer;
+    double tol_grad, tol_div;
+    physics::scheme_t scheme;
+
+    // Interface conductance on the face after each base cell, -1 if none
+    std::vector<int> iface_at;
+
+    // Patches of each level, level 0 is a single patch over the system
+    std::vector<std::vector<patch_t> > grid;
+  };
+}
+
+#endif /* AMR_HPP */
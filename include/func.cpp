@@ -12,13 +12,17 @@
 //  Mathematical functions:
 //  - Cross product
 //  - Dot product
+//  - Finite-difference weights
 //  - Gradient
+//  - Linear interpolation
 //  - SHM
 //
 //  GNU GPLv3. See LICENSE for details.
 // =======================================================
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 namespace func {
   // Perform cross product of two vectors v1 & v2
@@ -32,20 +36,89 @@ namespace func {
     return (v1[0]*v2[0])+(v1[1]*v2[1])+(v1[2]*v2[2]);
   }
 
-  // Calculate the gradient of a 1D array of vectors
-  std::vector<std::vector<double> > gradient(std::vector<std::vector<double> > vec, double stepsize) {
+  // First-derivative weights at z for values at positions pos[first, first+n)
+  // Fornberg, B. (1988). Generation of finite difference formulas on arbitrarily
+  // spaced grids. Mathematics of Computation, 51(184), 699-706.
+  std::vector<double> fd_weights(double z, const std::vector<double>& pos, int first, int n) {
+    // c0: interpolation weights, c1: first-derivative weights
+    std::vector<double> c0(n, 0.0), c1(n, 0.0);
+    c0[0] = 1.0;
+    double p1 = 1.0;
+    double d0 = pos[first]-z;
+    for (int i=1; i<n; i++) {
+      double p2 = 1.0;
+      double d1 = d0;
+      d0 = pos[first+i]-z;
+      for (int j=0; j<i; j++) {
+        double dx = pos[first+i]-pos[first+j];
+        p2 *= dx;
+        if (j == i-1) {
+          c1[i] = p1*(c0[i-1]-(d1*c1[i-1]))/p2;
+          c0[i] = -p1*d1*c0[i-1]/p2;
+        }
+        c1[j] = ((d0*c1[j])-c0[j])/dx;
+        c0[j] = d0*c0[j]/dx;
+      }
+      p1 = p2;
+    }
+    return c1;
+  }
+
+  // Calculate the gradient of a 1D array of vectors at (possibly non-uniform) positions pos
+  // order 2: three-point stencil, first order at the end points
+  // order 4, 6: centred (order+1)-point stencils, shifted inwards near the ends
+  // period > 0: periodic with that length, centred stencils wrap round the ends
+  std::vector<std::vector<double> > gradient(std::vector<std::vector<double> > vec, const std::vector<double>& pos, int order, double period) {
     // Empty gradient array
     std::vector<std::vector<double> > grad(vec.size(), std::vector<double>(vec[0].size()));
     std::fill(grad.begin(), grad.end(), std::vector<double> {0.0, 0.0, 0.0});
+
+    // Periodic, images of the cells one period either side
+    if (period > 0.0) {
+      int n = vec.size();
+      int half = order/2;
+      std::vector<double> pos_ext(n+(2*half));
+      for (int k=0; k<pos_ext.size(); k++) {
+        int i = ((k-half)%n+n)%n;
+        pos_ext[k] = pos[i]+(period*std::floor(double(k-half)/n));
+      }
+      for (int i=0; i<n; i++) {
+        std::vector<double> w = fd_weights(pos[i], pos_ext, i, order+1);
+        for (int j=0; j<vec[i].size(); j++) {
+          for (int k=0; k<=order; k++) grad[i][j] += w[k]*vec[((i+k-half)%n+n)%n][j];
+        }
+      }
+      return grad;
+    }
+
+    // Higher order, one-sided closures of the same order at the ends
+    int width = std::min(order+1, int(vec.size()));
+    if (order > 2 && width > 3) {
+      for(int i=0; i<vec.size(); i++){
+        int first = std::min(std::max(i-(order/2), 0), int(vec.size())-width);
+        std::vector<double> w = fd_weights(pos[i], pos, first, width);
+        for(int j=0; j<vec[i].size(); j++){
+          for(int k=0; k<width; k++) grad[i][j] += w[k]*vec[first+k][j];
+        }
+      }
+      return grad;
+    }
+
     // Calculate gradient at end points first
     for(int i=0; i<grad[0].size(); i++){
-      grad[0][i] = (vec[1][i]-vec[0][i])/(stepsize);
-      grad[grad.size()-1][i] = (vec[vec.size()-1][i]-vec[vec.size()-2][i])/(stepsize);
+      grad[0][i] = (vec[1][i]-vec[0][i])/(pos[1]-pos[0]);
+      grad[grad.size()-1][i] = (vec[vec.size()-1][i]-vec[vec.size()-2][i])/(pos[pos.size()-1]-pos[pos.size()-2]);
     }
 
+    // Three-point second-order stencil, central difference on a uniform grid
     for(int i=1; i<vec.size()-1; i++){
+      double h_l = pos[i]-pos[i-1];
+      double h_r = pos[i+1]-pos[i];
+      double w_l = -h_r/(h_l*(h_l+h_r));
+      double w_c = (h_r-h_l)/(h_l*h_r);
+      double w_r = h_l/(h_r*(h_l+h_r));
       for(int j=0; j<vec[i].size(); j++){
-        grad[i][j] = (vec[i+1][j]-vec[i-1][j])/(2*stepsize);
+        grad[i][j] = (w_l*vec[i-1][j])+(w_c*vec[i][j])+(w_r*vec[i+1][j]);
       }
 
     }
@@ -53,6 +126,69 @@ namespace func {
     return grad;
   }
 
+  // Gradient of a 1D array of scalars, stencils as for the vector gradient
+  std::vector<double> gradient(const std::vector<double>& vec, const std::vector<double>& pos, int order, double period) {
+    int n = vec.size();
+    std::vector<double> grad(n, 0.0);
+
+    // Periodic, images of the cells one period either side
+    if (period > 0.0) {
+      int half = order/2;
+      std::vector<double> pos_ext(n+(2*half));
+      for (int k=0; k<pos_ext.size(); k++) {
+        int i = ((k-half)%n+n)%n;
+        pos_ext[k] = pos[i]+(period*std::floor(double(k-half)/n));
+      }
+      for (int i=0; i<n; i++) {
+        std::vector<double> w = fd_weights(pos[i], pos_ext, i, order+1);
+        for (int k=0; k<=order; k++) grad[i] += w[k]*vec[((i+k-half)%n+n)%n];
+      }
+      return grad;
+    }
+
+    // Higher order, one-sided closures of the same order at the ends
+    int width = std::min(order+1, n);
+    if (order > 2 && width > 3) {
+      for (int i=0; i<n; i++) {
+        int first = std::min(std::max(i-(order/2), 0), n-width);
+        std::vector<double> w = fd_weights(pos[i], pos, first, width);
+        for (int k=0; k<width; k++) grad[i] += w[k]*vec[first+k];
+      }
+      return grad;
+    }
+
+    // End points, then the three-point stencil
+    grad[0] = (vec[1]-vec[0])/(pos[1]-pos[0]);
+    grad[n-1] = (vec[n-1]-vec[n-2])/(pos[n-1]-pos[n-2]);
+    for (int i=1; i<n-1; i++) {
+      double h_l = pos[i]-pos[i-1];
+      double h_r = pos[i+1]-pos[i];
+      double w_l = -h_r/(h_l*(h_l+h_r));
+      double w_c = (h_r-h_l)/(h_l*h_r);
+      double w_r = h_l/(h_r*(h_l+h_r));
+      grad[i] = (w_l*vec[i-1])+(w_c*vec[i])+(w_r*vec[i+1]);
+    }
+
+    return grad;
+  }
+
+  // Linear interpolation of a 1D array of vectors at increasing positions pos onto
+  // pos_new, held at the end values outside
+  std::vector<std::vector<double> > interpolate(const std::vector<std::vector<double> >& vec, const std::vector<double>& pos, const std::vector<double>& pos_new) {
+    std::vector<std::vector<double> > out(pos_new.size(), vec[0]);
+    for (int i=0; i<pos_new.size(); i++) {
+      int k = std::upper_bound(pos.begin(), pos.end(), pos_new[i])-pos.begin();
+      if (k == 0) continue;
+      if (k == pos.size()) {
+        out[i] = vec.back();
+        continue;
+      }
+      double w = (pos_new[i]-pos[k-1])/(pos[k]-pos[k-1]);
+      for (int j=0; j<vec[k].size(); j++) out[i][j] = ((1.0-w)*vec[k-1][j])+(w*vec[k][j]);
+    }
+    return out;
+  }
+
   // Test functions for integration
   // Performs Simple Harmonic Motion (sin/cos solutions)
   double dy_dt(std::vector<double> state){
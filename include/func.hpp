@@ -12,7 +12,9 @@
 //  Mathematical functions:
 //  - Cross product
 //  - Dot product
+//  - Finite-difference weights
 //  - Gradient
+//  - Linear interpolation
 //  - SHM
 //
 //  GNU GPLv3. See LICENSE for details.
@@ -28,7 +30,10 @@
 namespace func {
   std::vector<double> cross(std::vector<double> v1, std::vector<double> v2);
   double dot(std::vector<double> v1, std::vector<double> v2);
-  std::vector<std::vector<double> > gradient(std::vector<std::vector<double> > vec, double stepsize);
+  std::vector<double> fd_weights(double z, const std::vector<double>& pos, int first, int n);
+  std::vector<std::vector<double> > gradient(std::vector<std::vector<double> > vec, const std::vector<double>& pos, int order = 2, double period = 0.0);
+  std::vector<double> gradient(const std::vector<double>& vec, const std::vector<double>& pos, int order = 2, double period = 0.0);
+  std::vector<std::vector<double> > interpolate(const std::vector<std::vector<double> >& vec, const std::vector<double>& pos, const std::vector<double>& pos_new);
   double dy_dt(std::vector<double> state);
   double dz_dt(std::vector<double> state);
 }
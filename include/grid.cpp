@@ -0,0 +1,407 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: grid.cpp <CODE>
+//
+//  Spin accumulation on a uniform 2D/3D grid of cubic
+//  cells.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+// Standard libraries
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "grid.hpp"
+#include "physics.hpp"
+#include "transfer.hpp"
+#include "term.hpp"
+
+namespace grid {
+  template <int D>
+  domain_t<D>::domain_t(const std::vector<mat::material>& materials,
+                        double h,
+                        const std::vector<double>& width,
+                        const physics::scheme_t& scheme)
+    : h(h), cg_iter(0) {
+    // System length as for the 1D mesh
+    double min_x = materials.front().lower_bound;
+    double max_x = materials.back().upper_bound;
+    for (int i=0; i<materials.size(); i++) {
+      min_x = std::min(min_x, materials[i].lower_bound);
+      max_x = std::max(max_x, materials[i].upper_bound);
+    }
+    n[0] = ceil(((max_x-min_x)/h)-1e-9);
+    n[1] = n[2] = 1;
+    for (int d=1; d<D; d++) n[d] = std::max(int(ceil(width[d-1]/h)), 1);
+    stride[0] = 1;
+    stride[1] = n[0];
+    stride[2] = n[0]*n[1];
+
+    // Boxes, x cells as on the uniform 1D mesh, y and z by their centres
+    mat_id.assign(n[0]*n[1]*n[2], -1);
+    for (int m=0; m<materials.size(); m++) {
+      int lo[3], hi[3];
+      lo[0] = floor((materials[m].lower_bound/h)+1e-9);
+      hi[0] = std::min(int(floor((materials[m].upper_bound/h)+1e-9)), n[0]-1);
+      for (int d=1; d<3; d++) {
+        const std::vector<double>& bounds = (d == 1) ? materials[m].y_bounds : materials[m].z_bounds;
+        lo[d] = 0;
+        hi[d] = n[d]-1;
+        if (d < D && bounds.size() == 2) {
+          lo[d] = std::max(int(ceil((bounds[0]/h)-0.5)), 0);
+          hi[d] = std::min(int(ceil((bounds[1]/h)-0.5))-1, n[d]-1);
+        }
+      }
+      for (int i2=lo[2]; i2<=hi[2]; i2++) {
+        for (int i1=lo[1]; i1<=hi[1]; i1++) {
+          for (int i0=std::max(lo[0], 0); i0<=hi[0]; i0++) mat_id[i0+(stride[1]*i1)+(stride[2]*i2)] = m;
+        }
+      }
+    }
+
+    dm.assign(mat_id.size(), solver::vec_t<double>());
+    for (int c=0; c<dm.size(); c++) dm[c].fill(0.0);
+    dm_new = dm;
+    m_eq = dm;
+    r.assign(mat_id.size(), solver::zero<double>());
+    for (int c=0; c<mat_id.size(); c++) {
+      if (mat_id[c] < 0) continue;
+      const mat::material& mat = materials[mat_id[c]];
+      std::vector<double> mag = mat::magnetization(mat, (c%n[0])*h);
+      r[c] = physics::relax_tensor(mag, mat.scal_prop[4], mat.scal_prop[5], mat.scal_prop[6]);
+      for (int l=0; l<3; l++) m_eq[c][l] = mat.scal_prop[0]*mag[l];
+    }
+
+    conduct(materials);
+    couple(materials, scheme);
+  }
+
+  template <int D>
+  int domain_t<D>::active() const {
+    return mat_id.size()-std::count(mat_id.begin(), mat_id.end(), -1);
+  }
+
+  // Conductance matrix of the potential, sum over the faces of k*(phi(c) - phi(beyond)),
+  // phi = 0 beyond the grid, identity on insulating cells
+  template <int D>
+  void domain_t<D>::laplace(const std::vector<double>& phi, std::vector<double>& out) const {
+    #pragma omp parallel for schedule(static)
+    for (int row=0; row<n[1]*n[2]; row++) {
+      int i1 = row%n[1], i2 = row/n[1];
+      for (int i0=0; i0<n[0]; i0++) {
+        int c = i0+(stride[1]*i1)+(stride[2]*i2);
+        if (mat_id[c] < 0) {
+          out[c] = phi[c];
+          continue;
+        }
+        int i[3] = {i0, i1, i2};
+        double sum = 0.0;
+        for (int d=0; d<D; d++) {
+          int f = face(d, i0, i1, i2);
+          double k_lo = k[d][f], k_hi = k[d][f+stride[d]];
+          sum += (k_lo+k_hi)*phi[c];
+          if (i[d] > 0) sum -= k_lo*phi[c-stride[d]];
+          if (i[d] < n[d]-1) sum -= k_hi*phi[c+stride[d]];
+        }
+        out[c] = sum;
+      }
+    }
+  }
+
+  // Charge current of unit mean density through the left contact
+  template <int D>
+  void domain_t<D>::conduct(const std::vector<mat::material>& materials) {
+    int n_cells = mat_id.size();
+    std::vector<double> sigma(n_cells, 0.0);
+    for (int c=0; c<n_cells; c++) {
+      if (mat_id[c] >= 0) sigma[c] = materials[mat_id[c]].scal_prop[3];
+    }
+
+    // Face conductances, harmonic means inside, half cells to the contacts
+    for (int d=0; d<D; d++) {
+      int m[3] = {n[0], n[1], n[2]};
+      m[d]++;
+      k[d].assign(m[0]*m[1]*m[2], 0.0);
+      for (int i2=0; i2<m[2]; i2++) {
+        for (int i1=0; i1<m[1]; i1++) {
+          for (int i0=0; i0<m[0]; i0++) {
+            int i[3] = {i0, i1, i2};
+            int c = i0+(stride[1]*i1)+(stride[2]*i2);
+            double s_l = (i[d] > 0) ? sigma[c-stride[d]] : 0.0;
+            double s_r = (i[d] < n[d]) ? sigma[c] : 0.0;
+            double& kf = k[d][face(d, i0, i1, i2)];
+            if (s_l > 0.0 && s_r > 0.0) kf = 2.0*s_l*s_r/(s_l+s_r);
+            else if (d == 0 && (i0 == 0 || i0 == n[0])) kf = 2.0*(s_l+s_r);
+          }
+        }
+      }
+    }
+
+    // Jacobi-preconditioned conjugate gradients, phi = 1 on the left contact
+    std::vector<double> phi(n_cells, 0.0), res(n_cells, 0.0), diag(n_cells, 1.0);
+    for (int c=0; c<n_cells; c++) {
+      if (mat_id[c] < 0) continue;
+      int i0 = c%n[0], i1 = (c/n[0])%n[1], i2 = c/stride[2];
+      double sum = 0.0;
+      for (int d=0; d<D; d++) {
+        int f = face(d, i0, i1, i2);
+        sum += k[d][f]+k[d][f+stride[d]];
+      }
+      if (sum > 0.0) diag[c] = sum;
+      if (i0 == 0) res[c] = k[0][face(0, 0, i1, i2)];
+    }
+    double norm_b = 0.0;
+    for (int c=0; c<n_cells; c++) norm_b += res[c]*res[c];
+
+    std::vector<double> z(n_cells), p(n_cells), q(n_cells);
+    for (int c=0; c<n_cells; c++) p[c] = z[c] = res[c]/diag[c];
+    double rz = 0.0;
+    for (int c=0; c<n_cells; c++) rz += res[c]*z[c];
+    for (cg_iter=0; cg_iter<10*n_cells; cg_iter++) {
+      double norm_r = 0.0;
+      for (int c=0; c<n_cells; c++) norm_r += res[c]*res[c];
+      if (norm_r <= 1e-24*norm_b) break;
+
+      laplace(p, q);
+      double pq = 0.0;
+      for (int c=0; c<n_cells; c++) pq += p[c]*q[c];
+      double alpha = rz/pq;
+      for (int c=0; c<n_cells; c++) {
+        phi[c] += alpha*p[c];
+        res[c] -= alpha*q[c];
+        z[c] = res[c]/diag[c];
+      }
+      double rz_new = 0.0;
+      for (int c=0; c<n_cells; c++) rz_new += res[c]*z[c];
+      for (int c=0; c<n_cells; c++) p[c] = z[c]+((rz_new/rz)*p[c]);
+      rz = rz_new;
+    }
+
+    // Face currents k*(phi(l) - phi(r)), scaled by the current through the left contact
+    double total = 0.0;
+    int contact = 0;
+    for (int d=0; d<D; d++) {
+      j_f[d].assign(k[d].size(), 0.0);
+      int m[3] = {n[0], n[1], n[2]};
+      m[d]++;
+      for (int i2=0; i2<m[2]; i2++) {
+        for (int i1=0; i1<m[1]; i1++) {
+          for (int i0=0; i0<m[0]; i0++) {
+            int i[3] = {i0, i1, i2};
+            int c = i0+(stride[1]*i1)+(stride[2]*i2);
+            double phi_l = (i[d] > 0) ? phi[c-stride[d]] : ((d == 0) ? 1.0 : 0.0);
+            double phi_r = (i[d] < n[d]) ? phi[c] : 0.0;
+            int f = face(d, i0, i1, i2);
+            j_f[d][f] = k[d][f]*(phi_l-phi_r);
+            if (d == 0 && i0 == 0) {
+              total += j_f[d][f];
+              if (mat_id[c] >= 0) contact++;
+            }
+          }
+        }
+      }
+    }
+    if (total <= 0.0) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "No current path between the left and right faces of the grid" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    for (int d=0; d<D; d++) {
+      for (int f=0; f<j_f[d].size(); f++) j_f[d][f] *= contact/total;
+    }
+  }
+
+  // Face conductances and sources of the spin current, as in physics::assemble
+  template <int D>
+  void domain_t<D>::couple(const std::vector<mat::material>& materials, const physics::scheme_t& scheme) {
+    std::vector<solver::block_t<double> > c_mat(materials.size()), lead(materials.size());
+    std::vector<solver::vec_t<double> > jp_mat(materials.size());
+    for (int m=0; m<materials.size(); m++) {
+      const mat::material& mat = materials[m];
+      c_mat[m] = physics::diff_tensor(mat.mag, mat.scal_prop[1], mat.scal_prop[2], mat.scal_prop[3]);
+      for (int l=0; l<3; l++) jp_mat[m][l] = mat.scal_prop[1]*mat.mag[l];
+      if (scheme.bc_left == physics::bc_transparent || scheme.bc_right == physics::bc_transparent) lead[m] = transfer::lead_dtn(mat);
+    }
+
+    // Diffusion tensor and source of a cell, profiles evaluated at the cell rather
+    // than stored
+    auto cell = [&](int c, solver::block_t<double>& c_c, solver::vec_t<double>& jp_c) {
+      const mat::material& mat = materials[mat_id[c]];
+      if (mat.profile == "") {
+        c_c = c_mat[mat_id[c]];
+        jp_c = jp_mat[mat_id[c]];
+        return;
+      }
+      std::vector<double> mag = mat::magnetization(mat, (c%n[0])*h);
+      c_c = physics::diff_tensor(mag, mat.scal_prop[1], mat.scal_prop[2], mat.scal_prop[3]);
+      for (int l=0; l<3; l++) jp_c[l] = mat.scal_prop[1]*mag[l];
+    };
+
+    for (int d=0; d<D; d++) {
+      g[d].assign(k[d].size(), solver::zero<double>());
+      src[d].assign(k[d].size(), solver::vec_t<double>());
+      int m[3] = {n[0], n[1], n[2]};
+      m[d]++;
+      for (int i2=0; i2<m[2]; i2++) {
+        for (int i1=0; i1<m[1]; i1++) {
+          for (int i0=0; i0<m[0]; i0++) {
+            int i[3] = {i0, i1, i2};
+            int c = i0+(stride[1]*i1)+(stride[2]*i2);
+            int f = face(d, i0, i1, i2);
+            int mat_l = (i[d] > 0) ? mat_id[c-stride[d]] : -1;
+            int mat_r = (i[d] < n[d]) ? mat_id[c] : -1;
+            src[d][f].fill(0.0);
+
+            if (mat_l >= 0 && mat_r >= 0) {
+              solver::block_t<double> c_l, c_r, w_l, w_r;
+              solver::vec_t<double> jp_l, jp_r;
+              cell(c-stride[d], c_l, jp_l);
+              cell(c, c_r, jp_r);
+              physics::face_coeff(c_l, c_r, h, h, h, scheme.harmonic, g[d][f], w_l, w_r);
+              solver::vec_t<double> s_l = solver::mul(w_l, jp_l);
+              solver::vec_t<double> s_r = solver::mul(w_r, jp_r);
+              for (int l=0; l<3; l++) src[d][f][l] = j_f[d][f]*(s_l[l]+s_r[l]);
+            }
+
+            // Contacts, dm = 0 beyond the grid
+            else if (d == 0 && (i0 == 0 || i0 == n[0]) && std::max(mat_l, mat_r) >= 0) {
+              int end = (mat_r >= 0) ? c : c-1;
+              int bc = (mat_r >= 0) ? scheme.bc_left : scheme.bc_right;
+              solver::block_t<double> c_e, lead_e = lead[mat_id[end]];
+              solver::vec_t<double> jp_e;
+              cell(end, c_e, jp_e);
+              if (bc == physics::bc_transparent && materials[mat_id[end]].profile != "") {
+                mat::material mat = materials[mat_id[end]];
+                mat.mag = mat::magnetization(mat, (end%n[0])*h);
+                lead_e = transfer::lead_dtn(mat);
+              }
+              g[d][f] = physics::boundary_coeff(c_e, h, bc, lead_e);
+              if (bc != physics::bc_zero_flux) {
+                for (int l=0; l<3; l++) src[d][f][l] = j_f[d][f]*jp_e[l];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Spin current through the faces along d of the cells [lo, hi) at current j_e,
+  // packed with the tile's dimensions (one more face along d)
+  template <int D>
+  void domain_t<D>::flux(int d, const int* lo, const int* hi, double j_e, std::vector<solver::vec_t<double> >& out) const {
+    int top[3] = {hi[0], hi[1], hi[2]};
+    top[d]++;
+    out.resize((top[0]-lo[0])*(top[1]-lo[1])*(top[2]-lo[2]));
+    int a = 0;
+    for (int i2=lo[2]; i2<top[2]; i2++) {
+      for (int i1=lo[1]; i1<top[1]; i1++) {
+        int i_d = (d == 1) ? i1 : i2;
+        for (int i0=lo[0]; i0<top[0]; i0++, a++) {
+          if (d == 0) i_d = i0;
+          int c = i0+(stride[1]*i1)+(stride[2]*i2);
+          int f = face(d, i0, i1, i2);
+          solver::vec_t<double> diff;
+          for (int l=0; l<3; l++) {
+            diff[l] = (i_d < n[d]) ? dm[c][l] : 0.0;
+            if (i_d > 0) diff[l] -= dm[c-stride[d]][l];
+          }
+          solver::vec_t<double> g_diff = solver::mul(g[d][f], diff);
+          for (int l=0; l<3; l++) out[a][l] = (j_e*src[d][f][l])-g_diff[l];
+        }
+      }
+    }
+  }
+
+  // d(dm)/dt = -div J_m + R*dm, tile by tile
+  template <int D>
+  void domain_t<D>::step(double dt, double j_e) {
+    int n_tile[3];
+    for (int e=0; e<3; e++) n_tile[e] = (n[e]+tile[e]-1)/tile[e];
+
+    #pragma omp parallel
+    {
+      std::vector<solver::vec_t<double> > buf[D];
+
+      #pragma omp for schedule(static)
+      for (int t=0; t<n_tile[0]*n_tile[1]*n_tile[2]; t++) {
+        int t_i[3] = {t%n_tile[0], (t/n_tile[0])%n_tile[1], t/(n_tile[0]*n_tile[1])};
+        int lo[3], hi[3];
+        for (int e=0; e<3; e++) {
+          lo[e] = t_i[e]*tile[e];
+          hi[e] = std::min(lo[e]+tile[e], n[e]);
+        }
+        for (int d=0; d<D; d++) flux(d, lo, hi, j_e, buf[d]);
+
+        // Strides of the buffers, the upper face along d is one stride on
+        int w0 = hi[0]-lo[0], w1 = hi[1]-lo[1];
+        int b_stride[D];
+        for (int d=0; d<D; d++) b_stride[d] = (d == 0) ? 1 : ((d == 1) ? w0 : w0*(w1));
+        for (int i2=lo[2]; i2<hi[2]; i2++) {
+          for (int i1=lo[1]; i1<hi[1]; i1++) {
+            for (int i0=lo[0]; i0<hi[0]; i0++) {
+              int c = i0+(stride[1]*i1)+(stride[2]*i2);
+              if (mat_id[c] < 0) continue;
+              int a[3] = {i0-lo[0], i1-lo[1], i2-lo[2]};
+              solver::vec_t<double> rate = solver::mul(r[c], dm[c]);
+              for (int d=0; d<D; d++) {
+                int w[3] = {w0, w1, hi[2]-lo[2]};
+                w[d]++;
+                int b = a[0]+(w[0]*(a[1]+(w[1]*a[2])));
+                for (int l=0; l<3; l++) rate[l] -= (buf[d][b+b_stride[d]][l]-buf[d][b][l])/h;
+              }
+              for (int l=0; l<3; l++) dm_new[c][l] = dm[c][l]+(dt*rate[l]);
+            }
+          }
+        }
+      }
+    }
+    dm.swap(dm_new);
+  }
+
+  // One line per cell, x fastest with a blank line after each row:
+  // x y [z], J_m along x (mean of the two x faces), m, j_e (mean of the faces along each direction)
+  // x is the left edge of the cell as on the 1D mesh, y and z the centre
+  template <int D>
+  void domain_t<D>::write(std::string filename, double j_e) const {
+    std::ofstream myfile;
+    myfile.open(filename);
+    int lo[3] = {0, 0, 0};
+    std::vector<solver::vec_t<double> > j_x;
+    flux(0, lo, n, j_e, j_x);
+    for (int i2=0; i2<n[2]; i2++) {
+      for (int i1=0; i1<n[1]; i1++) {
+        for (int i0=0; i0<n[0]; i0++) {
+          int c = i0+(stride[1]*i1)+(stride[2]*i2);
+          int f = i0+((n[0]+1)*(i1+(n[1]*i2)));
+          myfile << i0*h << ' ' << (i1+0.5)*h << ' ';
+          if (D == 3) myfile << (i2+0.5)*h << ' ';
+          for (int l=0; l<3; l++) myfile << ((mat_id[c] < 0) ? 0.0 : 0.5*(j_x[f][l]+j_x[f+1][l])) << ' ';
+          for (int l=0; l<3; l++) myfile << dm[c][l]+m_eq[c][l] << ' ';
+          for (int d=0; d<D; d++) {
+            int f_d = face(d, i0, i1, i2);
+            myfile << 0.5*j_e*(j_f[d][f_d]+j_f[d][f_d+stride[d]]) << ' ';
+          }
+          myfile << std::endl;
+        }
+        myfile << std::endl;
+      }
+    }
+    myfile.close();
+  }
+
+  template class domain_t<2>;
+  template class domain_t<3>;
+}
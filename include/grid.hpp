@@ -0,0 +1,116 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: grid.hpp <HEADER>
+//
+//  Spin accumulation on a uniform 2D/3D grid of cubic
+//  cells, for lateral geometries such as nanopillars and
+//  nonlocal devices.
+//
+//  Each material is a box, x between its bounds (cells
+//  assigned as on the uniform 1D mesh) and y, z between
+//  its y_bounds and z_bounds (the whole width if unset).
+//  Later materials overwrite earlier ones, cells outside
+//  every box are insulating and carry no current. Magne-
+//  tization profiles (mat::magnetization) are evaluated
+//  at the cells while the coefficients are built, M is
+//  not stored on the grid.
+//
+//  The charge current is not uniform any more. It is the
+//  solution of div(sigma*grad(phi)) = 0 with the left and
+//  right faces of the grid as contacts and zero normal
+//  current on every other surface (conjugate gradients,
+//  Jacobi preconditioned), sigma taken as the diffusivity
+//  D_0 (the Einstein relation at equal density of states)
+//  and scaled to a mean density j_e over the active cells
+//  of the left contact.
+//
+//  dm is stepped explicitly with the face fluxes of phys-
+//  ics::assemble in every direction, J_m = w_l*B*j_f*M(l)
+//  + w_r*B*j_f*M(r) - g*(dm(r)-dm(l)) for the normal cur-
+//  rent j_f of the face, and the same outer conditions on
+//  the contacts. Kernels sweep the grid in tiles, the face
+//  fluxes of a tile are computed once into a tile buffer
+//  before its divergence, x is the contiguous direction.
+//
+//  The 1D system is solved by system_t as before, the grid
+//  is only built for dim > 1.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include <vector>
+#include <string>
+
+#include "material.hpp"
+#include "solver.hpp"
+#include "physics.hpp"
+
+namespace grid {
+  // Tile of the stencil kernels, cells in x, y, z
+  const int tile[3] = {64, 8, 8};
+
+  template <int D>
+  class domain_t {
+  public:
+    // Grid of cells h wide over the materials, width holds the extent in y (and z)
+    // Interfaces and the periodic and mirror conditions are not used
+    domain_t(const std::vector<mat::material>& materials,
+             double h,
+             const std::vector<double>& width,
+             const physics::scheme_t& scheme = physics::scheme_t());
+
+    // Explicit step of dm at the contact current density j_e
+    void step(double dt, double j_e);
+
+    // Cell centres, x-directed spin current, spin accumulation and charge current
+    void write(std::string filename, double j_e) const;
+
+    int cells() const {return mat_id.size();}
+    int active() const;
+    int iterations() const {return cg_iter;}
+
+  private:
+    void conduct(const std::vector<mat::material>& materials);
+    void couple(const std::vector<mat::material>& materials, const physics::scheme_t& scheme);
+    void laplace(const std::vector<double>& phi, std::vector<double>& out) const;
+    void flux(int d, const int* lo, const int* hi, double j_e, std::vector<solver::vec_t<double> >& out) const;
+
+    int face(int d, int i0, int i1, int i2) const {
+      int m[3] = {n[0], n[1], n[2]};
+      m[d]++;
+      return i0+(m[0]*(i1+(m[1]*i2)));
+    }
+
+    int n[3];                 // Cells along each direction, 1 beyond D
+    int stride[3];
+    double h;
+    int cg_iter;
+
+    // Cells, material (-1: insulating), relaxation R and equilibrium m_inf*M
+    std::vector<int> mat_id;
+    std::vector<solver::vec_t<double> > dm, dm_new, m_eq;
+    std::vector<solver::block_t<double> > r;
+
+    // Faces of each direction, n[d]+1 along d
+    // Normal charge current at unit j_e, conductance g and source, J_m = j_e*src - g*(dm(r)-dm(l))
+    // with dm = 0 beyond the grid
+    std::vector<double> j_f[D];
+    std::vector<solver::block_t<double> > g[D];
+    std::vector<solver::vec_t<double> > src[D];
+
+    // Conductance of the faces for the potential, contacts at x = 0 (phi = 1) and x = L (phi = 0)
+    std::vector<double> k[D];
+  };
+}
+
+#endif /* GRID_HPP */
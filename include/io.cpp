@@ -209,6 +209,16 @@ namespace io {
       exit(EXIT_FAILURE);
     }
   }
+  // Parse a bracketed list of numbers, [a, b, c]
+  std::vector<double> io_parse_list(std::string value_s) {
+    std::vector<double> list;
+    std::stringstream list_ss(value_s.substr(value_s.find("[")+1, value_s.find("]")-value_s.find("[")-1));
+    for (std::string item; std::getline(list_ss, item, ',');) {
+      if (item != "") list.push_back(std::stod(item));
+    }
+    return list;
+  }
+
   //   // Converts string unit input to exponent
   //   double io_unit(std::string io_unit_flag) {
   //     // Check variations for some quality of life
@@ -18,6 +18,9 @@
 #ifndef IO_HPP
 #define IO_HPP
 
+#include <string>
+#include <vector>
+
 namespace io {
   // IO flag for file/test mode
   extern unsigned int io_flag;
@@ -28,6 +31,9 @@ namespace io {
   // Read input file and return as vector to main
   extern  void io_read_file(int argc, char *argv[]);
 
+  // Parse a bracketed list of numbers, [a, b, c]
+  extern std::vector<double> io_parse_list(std::string value_s);
+
 }
 
 #endif /* IO_HPP */
@@ -16,6 +16,7 @@
 // =======================================================
 #include <vector>
 #include <string>
+#include <cmath>
 
 #include "material.hpp"
 
@@ -27,4 +28,41 @@ namespace mat {
                                           "len_precess",
                                           "len_dephase",
                                           "len_spin_flip"};
+
+  // Magnetization of the material at x, from its profile
+  // M = |mag|*(cos(theta)*e + sin(theta)*e_perp) about the easy axis e = mag/|mag|,
+  // e_perp is along e x x (bloch, helix) or the part of x normal to e (neel, cycloid)
+  std::vector<double> magnetization(const material& material, double x) {
+    const std::vector<double>& mag = material.mag;
+    double len = std::sqrt(mag[0]*mag[0]+mag[1]*mag[1]+mag[2]*mag[2]);
+    if (material.profile == "" || len == 0.0) return mag;
+
+    double e[3] = {mag[0]/len, mag[1]/len, mag[2]/len};
+    double perp[3];
+    if (material.profile == "bloch" || material.profile == "helix") {
+      perp[0] = 0.0;
+      perp[1] = e[2];
+      perp[2] = -e[1];
+    }
+    else {
+      perp[0] = 1.0-(e[0]*e[0]);
+      perp[1] = -e[0]*e[1];
+      perp[2] = -e[0]*e[2];
+    }
+    // Easy axis along x, rotate through z (y for neel)
+    double perp_len = std::sqrt(perp[0]*perp[0]+perp[1]*perp[1]+perp[2]*perp[2]);
+    if (perp_len < 1e-12) {
+      perp[0] = perp[1] = perp[2] = 0.0;
+      perp[(material.profile == "bloch" || material.profile == "helix") ? 2 : 1] = 1.0;
+      perp_len = 1.0;
+    }
+
+    double s = (x-material.profile_centre)/material.profile_width;
+    double theta = (material.profile == "bloch" || material.profile == "neel") ? 2.0*std::atan(std::exp(s)) : 2.0*M_PI*s;
+    if (material.chirality < 0) theta = -theta;
+
+    std::vector<double> m(3);
+    for (int i=0; i<3; i++) m[i] = len*((std::cos(theta)*e[i])+(std::sin(theta)*perp[i]/perp_len));
+    return m;
+  }
 }
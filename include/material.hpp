@@ -19,6 +19,7 @@
 #define MATERIAL_HPP
 
 #include <vector>
+#include <string>
 
 namespace mat {
   struct material {
@@ -26,6 +27,44 @@ namespace mat {
     double upper_bound;
     std::vector<double> mag;
     double len_diff;
+    double resolution;
+
+    // Interface at the lower boundary, zero thickness (0: none)
+    // J_m = G*(dm_left - dm_right), G = g along M and g_mix across it
+    // g_mix <= 0 takes the value of g
+    double iface_g;
+    double iface_g_mix;
+
+    // Lateral extent on a 2D/3D grid, [lower, upper] (empty: the whole width)
+    std::vector<double> y_bounds;
+    std::vector<double> z_bounds;
+
+    // Wire of the network mode the material is a layer of
+    int wire;
+
+    // Magnetization profile along x, mag is the easy axis (and length)
+    // "": uniform
+    // bloch, neel: domain wall centred at profile_centre of width profile_width,
+    //   M turns from mag to -mag across x (neel) or about x (bloch)
+    // cycloid, helix: spiral of period profile_width, M = mag at profile_centre
+    // chirality < 0 reverses the sense of rotation
+    // Only the 2D/3D grid evaluates the profile where it is needed. The 1D mesh
+    // samples it once into system_t::mag, the state of the magnetization dynamics.
+    std::string profile;
+    double profile_centre;
+    double profile_width;
+    int chirality;
+
+    // Magnetization dynamics (system:dt_mag > 0), M is fixed unless mag_sat > 0
+    // Gilbert damping, saturation magnetization and uniaxial anisotropy field along
+    // the initial magnetization (A/m)
+    double alpha;
+    double mag_sat;
+    double h_anis;
+
+    // Thermal noise of dm in evolve, standard deviation of its increment over a step
+    // per sqrt(dt) (0: none)
+    double noise;
 
     // Scalar properties
     // Properties indexing
@@ -43,6 +82,9 @@ namespace mat {
 
 
   extern std::vector<std::string> scal_prop_s;
+
+  // Magnetization of the material at x, from its profile
+  std::vector<double> magnetization(const material& material, double x);
 }
 
 #endif /* MATERIAL_HPP */
@@ -0,0 +1,117 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: network.cpp <CODE>
+//
+//  Steady state of a network of 1D wires.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+// Standard libraries
+#include <vector>
+#include <algorithm>
+
+#include "network.hpp"
+#include "physics.hpp"
+
+namespace network {
+  network_t::network_t(const std::vector<wire_t>& wires, int n_nodes, const std::vector<int>& ground)
+    : wires(wires) {
+    solver::vec_t<double> zero = {0.0, 0.0, 0.0};
+    dm.assign(n_nodes, zero);
+    for (int k=0; k<this->wires.size(); k++) respond(this->wires[k]);
+
+    // Unknowns at the free nodes, grounded and unconnected nodes stay at dm = 0
+    std::vector<int> id(n_nodes, -1);
+    std::vector<bool> held(n_nodes, true);
+    for (int k=0; k<wires.size(); k++) held[wires[k].first] = held[wires[k].last] = false;
+    for (int i=0; i<ground.size(); i++) held[ground[i]] = true;
+    int n = 0;
+    for (int v=0; v<n_nodes; v++) {
+      if (!held[v]) id[v] = n++;
+    }
+
+    // Net spin current out of each free node, area*J_first leaves the first node
+    // and area*J_last enters the last
+    std::vector<double> a(9*n*n, 0.0), b(3*n, 0.0);
+    auto add = [&](int row, int col, const solver::block_t<double>& s, double w) {
+      if (id[row] < 0 || id[col] < 0) return;
+      for (int i=0; i<3; i++) {
+        for (int j=0; j<3; j++) a[(((3*id[row])+i)*3*n)+(3*id[col])+j] += w*s[(3*i)+j];
+      }
+    };
+    for (int k=0; k<this->wires.size(); k++) {
+      const wire_t& w = this->wires[k];
+      add(w.first, w.first, w.s_ff, w.area);
+      add(w.first, w.last, w.s_fl, w.area);
+      add(w.last, w.first, w.s_lf, -w.area);
+      add(w.last, w.last, w.s_ll, -w.area);
+      for (int l=0; l<3; l++) {
+        if (id[w.first] >= 0) b[(3*id[w.first])+l] -= w.area*w.c_f[l];
+        if (id[w.last] >= 0) b[(3*id[w.last])+l] += w.area*w.c_l[l];
+      }
+    }
+    if (n > 0) solver::dense_solve(a, b);
+    for (int v=0; v<n_nodes; v++) {
+      if (id[v] < 0) continue;
+      for (int l=0; l<3; l++) dm[v][l] = b[(3*id[v])+l];
+    }
+
+    // Each wire between its node accumulations
+    for (int k=0; k<wires.size(); k++) {
+      stacks.push_back(transfer::stack_t(wires[k].materials, wires[k].j_e, physics::bc_equilibrium, physics::bc_equilibrium,
+                                         dm[wires[k].first], dm[wires[k].last]));
+    }
+  }
+
+  // End currents of a wire, by superposition of the source alone and unit dm held at
+  // each end in turn
+  void network_t::respond(wire_t& wire) const {
+    double x_first = wire.materials.front().lower_bound, x_last = wire.materials.front().upper_bound;
+    for (int i=0; i<wire.materials.size(); i++) {
+      x_first = std::min(x_first, wire.materials[i].lower_bound);
+      x_last = std::max(x_last, wire.materials[i].upper_bound);
+    }
+
+    solver::vec_t<double> zero = {0.0, 0.0, 0.0};
+    std::vector<double> m, j_f, j_l;
+    transfer::stack_t source(wire.materials, wire.j_e);
+    source.eval(x_first, m, j_f);
+    source.eval(x_last, m, j_l);
+    for (int l=0; l<3; l++) {
+      wire.c_f[l] = j_f[l];
+      wire.c_l[l] = j_l[l];
+    }
+
+    for (int col=0; col<3; col++) {
+      solver::vec_t<double> e = zero;
+      e[col] = 1.0;
+      transfer::stack_t from_first(wire.materials, 0.0, physics::bc_equilibrium, physics::bc_equilibrium, e, zero);
+      from_first.eval(x_first, m, j_f);
+      from_first.eval(x_last, m, j_l);
+      for (int l=0; l<3; l++) {
+        wire.s_ff[(3*l)+col] = j_f[l];
+        wire.s_lf[(3*l)+col] = j_l[l];
+      }
+      transfer::stack_t from_last(wire.materials, 0.0, physics::bc_equilibrium, physics::bc_equilibrium, zero, e);
+      from_last.eval(x_first, m, j_f);
+      from_last.eval(x_last, m, j_l);
+      for (int l=0; l<3; l++) {
+        wire.s_fl[(3*l)+col] = j_f[l];
+        wire.s_ll[(3*l)+col] = j_l[l];
+      }
+    }
+  }
+
+  // Spin accumulation and spin current along wire k at position x
+  void network_t::eval(int k, double x, std::vector<double>& m, std::vector<double>& j_m) const {
+    stacks[k].eval(x, m, j_m);
+  }
+}
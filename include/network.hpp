@@ -0,0 +1,77 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: network.hpp <HEADER>
+//
+//  Steady state of a network of 1D wires, such as a lat-
+//  eral nonlocal spin valve.
+//
+//  Each wire is a layered stack of materials (as in the
+//  transfer mode) running from a first to a last node,
+//  with its own charge current density and cross-section.
+//  At a node dm is continuous and the total spin current,
+//  area times J_m, is conserved. Ground nodes are held at
+//  equilibrium (dm = 0), like the contacts of the 1D sys-
+//  tem.
+//
+//  The interior of a wire is eliminated first: the stack
+//  is solved with unit dm held at either end and with the
+//  source alone, which gives its end currents as an affine
+//  function of the end accumulations,
+//
+//    J_first = s_ff*dm_first + s_fl*dm_last + c_f
+//    J_last  = s_lf*dm_first + s_ll*dm_last + c_l
+//
+//  Conservation at the free nodes is then a dense system
+//  of 3x3 blocks over the nodes only.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+#ifndef NETWORK_HPP
+#define NETWORK_HPP
+
+#include <vector>
+
+#include "material.hpp"
+#include "solver.hpp"
+#include "transfer.hpp"
+
+namespace network {
+  struct wire_t {
+    std::vector<mat::material> materials;  // Layers, positions along the wire
+    int first, last;                       // Nodes at the ends
+    double j_e;                            // Charge current density from first to last
+    double area;                           // Cross-section
+
+    // End currents from the end accumulations (see above)
+    solver::block_t<double> s_ff, s_fl, s_lf, s_ll;
+    solver::vec_t<double> c_f, c_l;
+  };
+
+  class network_t {
+  public:
+    network_t(const std::vector<wire_t>& wires, int n_nodes, const std::vector<int>& ground);
+
+    // Spin accumulation and spin current along wire k at position x
+    void eval(int k, double x, std::vector<double>& m, std::vector<double>& j_m) const;
+
+    // dm at the nodes
+    const std::vector<solver::vec_t<double> >& nodes() const {return dm;}
+
+  private:
+    void respond(wire_t& wire) const;
+
+    std::vector<wire_t> wires;
+    std::vector<transfer::stack_t> stacks;
+    std::vector<solver::vec_t<double> > dm;
+  };
+}
+
+#endif /* NETWORK_HPP */
@@ -28,9 +28,12 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <complex>
 
 // Mathematical functions
 #include "func.hpp"
+#include "physics.hpp"
+#include "random.hpp"
 
 namespace physics{
   // Calculate the spin current across the system
@@ -40,10 +43,12 @@ namespace physics{
                                               std::vector<double> spin_polar_diff,
                                               std::vector<double> diff,
                                               double electric_curr,
-                                              double stepsize) {
+                                              const std::vector<double>& pos,
+                                              int order,
+                                              double period) {
     // Perform gradient of spin accumulation
     // Doing this inside the function allows for integration method to be independent
-    std::vector<std::vector<double> > spin_accum_grad = func::gradient(spin_accum, stepsize);
+    std::vector<std::vector<double> > spin_accum_grad = func::gradient(spin_accum, pos, order, period);
 
     // Empty spin current vector
     std::vector<std::vector<double> > j_m(spin_accum_grad.size(), std::vector<double>(3));
@@ -70,9 +75,11 @@ namespace physics{
                                           std::vector<double> dephasing_len,
                                           std::vector<double> spin_flip_len,
                                           std::vector<double> spin_accum_inf,
-                                          double stepsize) {
+                                          const std::vector<double>& pos,
+                                          int order,
+                                          double period) {
 
-    std::vector<std::vector<double> > spin_curr_grad = func::gradient(spin_curr, stepsize);
+    std::vector<std::vector<double> > spin_curr_grad = func::gradient(spin_curr, pos, order, period);
     std::vector<std::vector<double> > dm_dt(spin_accum.size(), std::vector<double>(3));
 
 
@@ -106,4 +113,546 @@ namespace physics{
 
   }
 
+  // Thermal noise of the spin accumulation, Euler-Maruyama increment
+  void add_noise(std::vector<std::vector<double> >& spin_accum,
+                 const std::vector<double>& amplitude,
+                 double dt,
+                 uint64_t step,
+                 uint32_t seed) {
+    int n = spin_accum.size();
+    std::vector<double> xi(3*n);
+    rng::normals(0, n, step, seed, xi.data());
+    double sqrt_dt = std::sqrt(dt);
+    for (int i=0; i<n; i++) {
+      for (int j=0; j<3; j++) spin_accum[i][j] += amplitude[i]*sqrt_dt*xi[(3*i)+j];
+    }
+  }
+
+  // Landau-Lifshitz-Gilbert rate of M driven by the spin accumulation
+  std::vector<double> llg_rate(const std::vector<double>& mag,
+                               const std::vector<double>& dm,
+                               const std::vector<double>& h_eff,
+                               double alpha,
+                               double mag_sat,
+                               double precession_len,
+                               double dephasing_len) {
+    std::vector<double> rate(3, 0.0);
+    double len = std::sqrt(func::dot(mag, mag));
+    if (len == 0.0 || mag_sat <= 0.0) return rate;
+    std::vector<double> u = {mag[0]/len, mag[1]/len, mag[2]/len};
+
+    // Precession about h_eff and the torque, (dm x M)/L_j^2 + M x (dm x M)/L_phi^2
+    std::vector<double> dm_mag_cross = func::cross(dm, mag);
+    std::vector<double> mag_dm_mag_cross = func::cross(mag, dm_mag_cross);
+    std::vector<double> u_h_cross = func::cross(u, h_eff);
+    std::vector<double> f(3);
+    for (int j=0; j<3; j++) {
+      f[j] = (-gamma_0*u_h_cross[j])+(((dm_mag_cross[j]/pow(precession_len,2))+(mag_dm_mag_cross[j]/pow(dephasing_len,2)))/mag_sat);
+    }
+
+    // Damping, du/dt = (f + alpha*u x f)/(1 + alpha^2) as f is normal to u
+    std::vector<double> u_f_cross = func::cross(u, f);
+    for (int j=0; j<3; j++) rate[j] = len*(f[j]+(alpha*u_f_cross[j]))/(1.0+(alpha*alpha));
+    return rate;
+  }
+
+  // Spin current along the common axis of a collinear system
+  std::vector<double> spin_curr_collinear(const std::vector<double>& spin_accum,
+                                          const std::vector<double>& mag,
+                                          const std::vector<double>& spin_polar_con,
+                                          const std::vector<double>& spin_polar_diff,
+                                          const std::vector<double>& diff,
+                                          double electric_curr,
+                                          const std::vector<double>& pos,
+                                          int order,
+                                          double period) {
+    std::vector<double> spin_accum_grad = func::gradient(spin_accum, pos, order, period);
+    std::vector<double> j_m(spin_accum_grad.size());
+    for (int i=0; i<j_m.size(); i++) {
+      // J_m = B*M*j_e - 2D[dm_dx - B*B'*M(M*dm_dx)]
+      j_m[i] = spin_polar_con[i]*electric_curr*mag[i] -
+        ((2.0*diff[i])*(spin_accum_grad[i]-(spin_polar_con[i]*spin_polar_diff[i]*mag[i]*(mag[i]*spin_accum_grad[i]))));
+    }
+    return j_m;
+  }
+
+  // Equation of motion along the common axis, diffusion and spin flip only
+  std::vector<double> dm_dt_collinear(const std::vector<double>& spin_accum,
+                                      const std::vector<double>& mag,
+                                      const std::vector<double>& spin_curr,
+                                      const std::vector<double>& spin_flip_len,
+                                      const std::vector<double>& spin_accum_inf,
+                                      const std::vector<double>& pos,
+                                      int order,
+                                      double period) {
+    std::vector<double> spin_curr_grad = func::gradient(spin_curr, pos, order, period);
+    std::vector<double> dm_dt(spin_accum.size());
+    for (int i=0; i<dm_dt.size(); i++) {
+      dm_dt[i] = (-1.0*spin_curr_grad[i])+((-1.0*(spin_accum[i]-(mag[i]*spin_accum_inf[i])))/(pow(spin_flip_len[i],2)));
+    }
+    return dm_dt;
+  }
+
+  // Diffusion tensor 2D(I - B*B'*MM^T)
+  solver::block_t<double> diff_tensor(const std::vector<double>& mag,
+                                      double spin_polar_con,
+                                      double spin_polar_diff,
+                                      double diff) {
+    solver::block_t<double> c;
+    for (int j=0; j<3; j++) {
+      for (int k=0; k<3; k++) {
+        c[3*j+k] = 2.0*diff*((j==k ? 1.0 : 0.0)-(spin_polar_con*spin_polar_diff*mag[j]*mag[k]));
+      }
+    }
+    return c;
+  }
+
+  // Relaxation tensor, -(m x M)/L_j^2 - M x (m x M)/L_phi^2 - (m - m_inf*M)/L_sf^2
+  solver::block_t<double> relax_tensor(const std::vector<double>& mag,
+                                       double precession_len,
+                                       double dephasing_len,
+                                       double spin_flip_len) {
+    solver::block_t<double> r = solver::scale(solver::identity<double>(), -1.0/pow(spin_flip_len,2));
+
+    // Precession and dephasing vanish without magnetization
+    double mag_sq = func::dot(mag, mag);
+    if (mag_sq == 0.0) return r;
+
+    // -(m x M) = [M]x m
+    double p = 1.0/pow(precession_len,2);
+    r[1] -= mag[2]*p; r[2] += mag[1]*p;
+    r[3] += mag[2]*p; r[5] -= mag[0]*p;
+    r[6] -= mag[1]*p; r[7] += mag[0]*p;
+
+    // -M x (m x M) = -(|M|^2 I - MM^T) m
+    double d = 1.0/pow(dephasing_len,2);
+    for (int j=0; j<3; j++) {
+      for (int k=0; k<3; k++) {
+        r[3*j+k] -= d*((j==k ? mag_sq : 0.0)-(mag[j]*mag[k]));
+      }
+    }
+    return r;
+  }
+
+  // Face coefficients between cells l and r
+  void face_coeff(const solver::block_t<double>& c_l,
+                  const solver::block_t<double>& c_r,
+                  double width_l,
+                  double width_r,
+                  double dist,
+                  bool harmonic,
+                  solver::block_t<double>& g,
+                  solver::block_t<double>& w_l,
+                  solver::block_t<double>& w_r) {
+    if (!harmonic) {
+      g = solver::scale(solver::add(c_l, c_r), 0.5/dist);
+      w_l = w_r = solver::scale(solver::identity<double>(), 0.5);
+      return;
+    }
+
+    // Half-cell conductances a = C/(h/2), g = a_l*(a_l+a_r)^-1*a_r
+    // Continuity at the face: dm_f = (a_l+a_r)^-1*(a_l*dm_l + a_r*dm_r + B*j_e*(M_l-M_r))
+    solver::block_t<double> a_l = solver::scale(c_l, 2.0/width_l);
+    solver::block_t<double> a_r = solver::scale(c_r, 2.0/width_r);
+
+    // No diffusion on either side
+    if (a_l[0]+a_l[4]+a_l[8]+a_r[0]+a_r[4]+a_r[8] == 0.0) {
+      g = solver::zero<double>();
+      w_l = w_r = solver::scale(solver::identity<double>(), 0.5);
+      return;
+    }
+
+    solver::block_t<double> s_inv = solver::inv(solver::add(a_l, a_r));
+    w_r = solver::mul(a_l, s_inv);
+    w_l = solver::mul(a_r, s_inv);
+    g = solver::mul(w_r, a_r);
+  }
+
+  // Interface conductance tensor, g along the magnetization and g_mix across it
+  solver::block_t<double> iface_tensor(const std::vector<double>& mag_l,
+                                       const std::vector<double>& mag_r,
+                                       double g,
+                                       double g_mix) {
+    if (g_mix <= 0.0) g_mix = g;
+
+    // Axis from the magnetic side
+    std::vector<double> axis = (func::dot(mag_r, mag_r) > 0.0) ? mag_r : mag_l;
+    double axis_sq = func::dot(axis, axis);
+    if (axis_sq == 0.0) return solver::scale(solver::identity<double>(), g);
+
+    // g_mix*(I - uu^T) + g*uu^T
+    solver::block_t<double> t;
+    for (int j=0; j<3; j++) {
+      for (int k=0; k<3; k++) {
+        t[3*j+k] = ((j==k ? g_mix : 0.0))+((g-g_mix)*axis[j]*axis[k]/axis_sq);
+      }
+    }
+    return t;
+  }
+
+  // Face split by an interface, resistances in series
+  // J_m = T*(dm_l - dm_r) + T*a_l^-1*B*j_e*M_l + T*a_r^-1*B*j_e*M_r
+  // T = (a_l^-1 + g_iface^-1 + a_r^-1)^-1, a = C/(h/2)
+  void iface_coeff(const solver::block_t<double>& c_l,
+                   const solver::block_t<double>& c_r,
+                   double width_l,
+                   double width_r,
+                   const solver::block_t<double>& g_iface,
+                   solver::block_t<double>& g,
+                   solver::block_t<double>& w_l,
+                   solver::block_t<double>& w_r) {
+    solver::block_t<double> r_l = solver::inv(solver::scale(c_l, 2.0/width_l));
+    solver::block_t<double> r_r = solver::inv(solver::scale(c_r, 2.0/width_r));
+    g = solver::inv(solver::add(solver::add(r_l, r_r), solver::inv(g_iface)));
+    w_l = solver::mul(g, r_l);
+    w_r = solver::mul(g, r_r);
+  }
+
+  // Outer face conductance from the end cell centre
+  solver::block_t<double> boundary_coeff(const solver::block_t<double>& c,
+                                         double width,
+                                         int bc,
+                                         const solver::block_t<double>& lead) {
+    if (bc == bc_zero_flux) return solver::zero<double>();
+    solver::block_t<double> g = solver::scale(c, 2.0/width);
+    if (bc == bc_transparent) g = solver::inv(solver::add(solver::inv(g), solver::inv(lead)));
+    return g;
+  }
+
+  // Cell-centred mean of the face currents
+  std::vector<std::vector<double> > cell_average(const std::vector<solver::vec_t<double> >& j_face) {
+    int n = j_face.size()-1;
+    std::vector<std::vector<double> > j_m(n, std::vector<double>(3));
+    for (int i=0; i<n; i++) {
+      for (int j=0; j<3; j++) j_m[i][j] = 0.5*(j_face[i][j]+j_face[i+1][j]);
+    }
+    return j_m;
+  }
+
+  // Coefficients of the interior faces, J_m(i+1/2) = w_l*B*j_e*M(i) + w_r*B*j_e*M(i+1) - g*(dm(i+1)-dm(i))
+  // Periodic systems have a further face n-1 joining the last cell to the first
+  void face_coeffs(const std::vector<solver::block_t<double> >& c,
+                   const std::vector<double>& pos,
+                   const std::vector<double>& width,
+                   const scheme_t& scheme,
+                   std::vector<solver::block_t<double> >& g,
+                   std::vector<solver::block_t<double> >& w_l,
+                   std::vector<solver::block_t<double> >& w_r) {
+    int n = c.size();
+    int n_face = (scheme.bc_left == bc_periodic) ? n : n-1;
+    g.resize(n_face);
+    w_l.resize(n_face);
+    w_r.resize(n_face);
+    for (int i=0; i<n-1; i++) {
+      face_coeff(c[i], c[i+1], width[i], width[i+1], pos[i+1]-pos[i], scheme.harmonic, g[i], w_l[i], w_r[i]);
+    }
+    if (n_face == n) {
+      face_coeff(c[n-1], c[0], width[n-1], width[0], 0.5*(width[n-1]+width[0]), scheme.harmonic, g[n-1], w_l[n-1], w_r[n-1]);
+    }
+    for (int k=0; k<scheme.iface.size(); k++) {
+      int i = scheme.iface[k].face;
+      if (i >= n_face) continue;
+      iface_coeff(c[i], c[(i+1)%n], width[i], width[(i+1)%n], scheme.iface[k].g, g[i], w_l[i], w_r[i]);
+    }
+  }
+
+  // Face between the last cell and its mirror image, dm = -S*dm(n-1) and B*j_e*M = S*B*j_e*M(n-1)
+  // beyond it, so J_m = w_l*B*j_e*M + w_r*S*B*j_e*M + g*(I+S)*dm(n-1)
+  void mirror_coeff(const solver::block_t<double>& c,
+                    double width,
+                    int n,
+                    const scheme_t& scheme,
+                    solver::block_t<double>& g,
+                    solver::block_t<double>& w_l,
+                    solver::block_t<double>& w_r) {
+    solver::block_t<double> c_image = solver::mul(scheme.mirror, solver::mul(c, scheme.mirror));
+    face_coeff(c, c_image, width, width, width, scheme.harmonic, g, w_l, w_r);
+    for (int k=0; k<scheme.iface.size(); k++) {
+      if (scheme.iface[k].face == n-1) iface_coeff(c, c_image, width, width, scheme.iface[k].g, g, w_l, w_r);
+    }
+  }
+
+  // Linear form of the equation of motion for dm = m - m_inf*M
+  void assemble(const std::vector<std::vector<double> >& mag,
+                const std::vector<std::vector<double> >& scal_prop,
+                const std::vector<double>& pos,
+                const std::vector<double>& width,
+                solver::btd_t<double>& a,
+                std::vector<solver::vec_t<double> >& b,
+                const scheme_t& scheme) {
+    int n = mag.size();
+
+    a.resize(n);
+
+    // Cell tensors
+    std::vector<solver::block_t<double> > c(n);
+    for (int i=0; i<n; i++) {
+      c[i] = diff_tensor(mag[i], scal_prop[1][i], scal_prop[2][i], scal_prop[3][i]);
+      a.diag[i] = relax_tensor(mag[i], scal_prop[4][i], scal_prop[5][i], scal_prop[6][i]);
+    }
+
+    // Interior faces
+    // J_m(i+1/2) = B*j_e*M - g*(dm(i+1)-dm(i))
+    std::vector<solver::block_t<double> > g, w_l, w_r;
+    face_coeffs(c, pos, width, scheme, g, w_l, w_r);
+    // Periodic systems wrap the last face round to the first cell
+    for (int i=0; i<g.size(); i++) {
+      int r = (i+1)%n;
+      a.upper[i] = solver::add(a.upper[i], solver::scale(g[i], 1.0/width[i]));
+      a.diag[i]  = solver::sub(a.diag[i], solver::scale(g[i], 1.0/width[i]));
+      a.lower[r] = solver::add(a.lower[r], solver::scale(g[i], 1.0/width[r]));
+      a.diag[r]  = solver::sub(a.diag[r], solver::scale(g[i], 1.0/width[r]));
+    }
+    a.cyclic = (scheme.bc_left == bc_periodic);
+
+    // Outer faces, at equilibrium half a cell beyond the end cells by default
+    if (scheme.bc_left == bc_equilibrium) {
+      a.diag[0] = solver::sub(a.diag[0], solver::scale(c[0], 2.0/(width[0]*width[0])));
+    }
+    else if (scheme.bc_left != bc_periodic) {
+      solver::block_t<double> g_left = boundary_coeff(c[0], width[0], scheme.bc_left, scheme.lead_left);
+      a.diag[0] = solver::sub(a.diag[0], solver::scale(g_left, 1.0/width[0]));
+    }
+    if (scheme.bc_right == bc_equilibrium) {
+      a.diag[n-1] = solver::sub(a.diag[n-1], solver::scale(c[n-1], 2.0/(width[n-1]*width[n-1])));
+    }
+    else if (scheme.bc_right == bc_mirror) {
+      solver::block_t<double> g_m, w_l_m, w_r_m;
+      mirror_coeff(c[n-1], width[n-1], n, scheme, g_m, w_l_m, w_r_m);
+      solver::block_t<double> g_right = solver::mul(g_m, solver::add(solver::identity<double>(), scheme.mirror));
+      a.diag[n-1] = solver::sub(a.diag[n-1], solver::scale(g_right, 1.0/width[n-1]));
+    }
+    else if (scheme.bc_right != bc_periodic) {
+      solver::block_t<double> g_right = boundary_coeff(c[n-1], width[n-1], scheme.bc_right, scheme.lead_right);
+      a.diag[n-1] = solver::sub(a.diag[n-1], solver::scale(g_right, 1.0/width[n-1]));
+    }
+
+    // Unit current
+    b = source_current(mag, scal_prop, std::vector<double>(n, 1.0), width, scheme);
+  }
+
+  // Source term of a current distribution, -d(B*j_e*M)/dx on the faces
+  std::vector<solver::vec_t<double> > source_current(const std::vector<std::vector<double> >& mag,
+                                                     const std::vector<std::vector<double> >& scal_prop,
+                                                     const std::vector<double>& electric_curr,
+                                                     const std::vector<double>& width,
+                                                     const scheme_t& scheme) {
+    int n = mag.size();
+    std::vector<solver::vec_t<double> > b(n);
+    for (int i=0; i<n; i++) b[i].fill(0.0);
+
+    // Face weights, averaged unless harmonic or split by an interface
+    std::vector<solver::block_t<double> > c(n);
+    std::vector<double> pos(n, 0.0);
+    for (int i=0; i<n; i++) {
+      c[i] = diff_tensor(mag[i], scal_prop[1][i], scal_prop[2][i], scal_prop[3][i]);
+      if (i > 0) pos[i] = pos[i-1]+(0.5*(width[i-1]+width[i]));
+    }
+    std::vector<solver::block_t<double> > g, w_l, w_r;
+    face_coeffs(c, pos, width, scheme, g, w_l, w_r);
+
+    // Interior faces, and the wrap face of a periodic system
+    for (int i=0; i<g.size(); i++) {
+      int r = (i+1)%n;
+      solver::vec_t<double> j_l, j_r;
+      for (int j=0; j<3; j++) {
+        j_l[j] = scal_prop[1][i]*electric_curr[i]*mag[i][j];
+        j_r[j] = scal_prop[1][r]*electric_curr[r]*mag[r][j];
+      }
+      solver::vec_t<double> f_l = solver::mul(w_l[i], j_l);
+      solver::vec_t<double> f_r = solver::mul(w_r[i], j_r);
+      for (int j=0; j<3; j++) {
+        b[i][j] -= (f_l[j]+f_r[j])/width[i];
+        b[r][j] += (f_l[j]+f_r[j])/width[r];
+      }
+    }
+    if (scheme.bc_left == bc_periodic) return b;
+
+    // Mirror face, the last cell and its image
+    if (scheme.bc_right == bc_mirror) {
+      solver::block_t<double> g_m, w_l_m, w_r_m;
+      mirror_coeff(c[n-1], width[n-1], n, scheme, g_m, w_l_m, w_r_m);
+      solver::vec_t<double> j_p;
+      for (int j=0; j<3; j++) j_p[j] = scal_prop[1][n-1]*electric_curr[n-1]*mag[n-1][j];
+      solver::vec_t<double> f_l = solver::mul(w_l_m, j_p);
+      solver::vec_t<double> f_r = solver::mul(w_r_m, solver::mul(scheme.mirror, j_p));
+      for (int j=0; j<3; j++) b[n-1][j] -= (f_l[j]+f_r[j])/width[n-1];
+    }
+
+    // Outer faces take the end cell values, none through a zero-flux face
+    for (int j=0; j<3; j++) {
+      if (scheme.bc_left != bc_zero_flux) b[0][j] += scal_prop[1][0]*electric_curr[0]*mag[0][j]/width[0];
+      if (scheme.bc_right != bc_zero_flux && scheme.bc_right != bc_mirror) b[n-1][j] -= scal_prop[1][n-1]*electric_curr[n-1]*mag[n-1][j]/width[n-1];
+    }
+    return b;
+  }
+
+  // Cell-centred spin current of the finite-volume discretization
+  std::vector<std::vector<double> > spin_curr_fv(const std::vector<std::vector<double> >& spin_accum,
+                                                 const std::vector<std::vector<double> >& mag,
+                                                 const std::vector<std::vector<double> >& scal_prop,
+                                                 double electric_curr,
+                                                 const std::vector<double>& pos,
+                                                 const std::vector<double>& width,
+                                                 const std::vector<double>& dm_left,
+                                                 const std::vector<double>& dm_right,
+                                                 const scheme_t& scheme) {
+    int n = mag.size();
+    std::vector<solver::block_t<double> > c(n);
+    std::vector<solver::vec_t<double> > j_p(n), dm(n);
+    for (int i=0; i<n; i++) {
+      c[i] = diff_tensor(mag[i], scal_prop[1][i], scal_prop[2][i], scal_prop[3][i]);
+      for (int j=0; j<3; j++) {
+        j_p[i][j] = scal_prop[1][i]*electric_curr*mag[i][j];
+        dm[i][j] = spin_accum[i][j];
+      }
+    }
+
+    // Face currents
+    std::vector<solver::block_t<double> > g, w_l, w_r;
+    face_coeffs(c, pos, width, scheme, g, w_l, w_r);
+    std::vector<solver::vec_t<double> > j_face(n+1);
+    for (int i=0; i<g.size(); i++) {
+      int r = (i+1)%n;
+      solver::vec_t<double> f_l = solver::mul(w_l[i], j_p[i]);
+      solver::vec_t<double> f_r = solver::mul(w_r[i], j_p[r]);
+      solver::vec_t<double> diff = solver::mul(g[i], solver::sub(dm[r], dm[i]));
+      for (int j=0; j<3; j++) j_face[i+1][j] = f_l[j]+f_r[j]-diff[j];
+    }
+
+    // Outer faces, the wrap face on both ends of a periodic system
+    if (scheme.bc_left == bc_periodic) {
+      j_face[0] = j_face[n];
+      return cell_average(j_face);
+    }
+    solver::vec_t<double> dm_l = {{dm_left[0], dm_left[1], dm_left[2]}};
+    solver::vec_t<double> dm_r = {{dm_right[0], dm_right[1], dm_right[2]}};
+    solver::vec_t<double> diff_l = solver::mul(boundary_coeff(c[0], width[0], scheme.bc_left, scheme.lead_left), solver::sub(dm[0], dm_l));
+    solver::vec_t<double> diff_r = solver::mul(boundary_coeff(c[n-1], width[n-1], scheme.bc_right, scheme.lead_right), solver::sub(dm_r, dm[n-1]));
+    for (int j=0; j<3; j++) {
+      j_face[0][j] = ((scheme.bc_left != bc_zero_flux) ? j_p[0][j] : 0.0)-diff_l[j];
+      j_face[n][j] = ((scheme.bc_right != bc_zero_flux) ? j_p[n-1][j] : 0.0)-diff_r[j];
+    }
+    if (scheme.bc_right == bc_mirror) {
+      solver::block_t<double> g_m, w_l_m, w_r_m;
+      mirror_coeff(c[n-1], width[n-1], n, scheme, g_m, w_l_m, w_r_m);
+      solver::vec_t<double> f_l = solver::mul(w_l_m, j_p[n-1]);
+      solver::vec_t<double> f_r = solver::mul(w_r_m, solver::mul(scheme.mirror, j_p[n-1]));
+      solver::vec_t<double> diff = solver::mul(g_m, solver::mul(solver::add(solver::identity<double>(), scheme.mirror), dm[n-1]));
+      for (int j=0; j<3; j++) j_face[n][j] = f_l[j]+f_r[j]+diff[j];
+    }
+    return cell_average(j_face);
+  }
+
+  // Periodic operator for a Bloch phase, built from the real one
+  void assemble_bloch(const std::vector<std::vector<double> >& mag,
+                      const std::vector<std::vector<double> >& scal_prop,
+                      const std::vector<double>& pos,
+                      const std::vector<double>& width,
+                      double phase,
+                      solver::btd_t<cplx>& a,
+                      std::vector<solver::vec_t<cplx> >& b,
+                      const scheme_t& scheme) {
+    int n = mag.size();
+    solver::btd_t<double> a_re;
+    std::vector<solver::vec_t<double> > b_re;
+    assemble(mag, scal_prop, pos, width, a_re, b_re, scheme);
+
+    a.resize(n);
+    a.cyclic = true;
+    b.resize(n);
+    for (int i=0; i<n; i++) {
+      for (int k=0; k<9; k++) {
+        a.lower[i][k] = a_re.lower[i][k];
+        a.diag[i][k] = a_re.diag[i][k];
+        a.upper[i][k] = a_re.upper[i][k];
+      }
+      for (int j=0; j<3; j++) b[i][j] = b_re[i][j];
+    }
+
+    // Only the wrap face sees the neighbouring periods, dm(-1) = exp(-i*phase)*dm(n-1)
+    // and dm(n) = exp(i*phase)*dm(0), the same for the source
+    cplx q = std::polar(1.0, phase);
+    a.lower[0] = solver::scale(a.lower[0], std::conj(q));
+    a.upper[n-1] = solver::scale(a.upper[n-1], q);
+
+    std::vector<solver::block_t<double> > c(n);
+    std::vector<solver::vec_t<double> > j_p(n);
+    for (int i=0; i<n; i++) {
+      c[i] = diff_tensor(mag[i], scal_prop[1][i], scal_prop[2][i], scal_prop[3][i]);
+      for (int j=0; j<3; j++) j_p[i][j] = scal_prop[1][i]*mag[i][j];
+    }
+    std::vector<solver::block_t<double> > g, w_l, w_r;
+    face_coeffs(c, pos, width, scheme, g, w_l, w_r);
+    solver::vec_t<double> f_l = solver::mul(w_l[n-1], j_p[n-1]);
+    solver::vec_t<double> f_r = solver::mul(w_r[n-1], j_p[0]);
+    for (int j=0; j<3; j++) {
+      b[0][j] += (std::conj(q)-1.0)*f_l[j]/width[0];
+      b[n-1][j] -= (q-1.0)*f_r[j]/width[n-1];
+    }
+  }
+
+  // Cell-centred spin current of a Bloch solution
+  std::vector<solver::vec_t<cplx> > spin_curr_bloch(const std::vector<solver::vec_t<cplx> >& dm,
+                                                    const std::vector<std::vector<double> >& mag,
+                                                    const std::vector<std::vector<double> >& scal_prop,
+                                                    double electric_curr,
+                                                    const std::vector<double>& pos,
+                                                    const std::vector<double>& width,
+                                                    double phase,
+                                                    const scheme_t& scheme) {
+    int n = mag.size();
+    std::vector<solver::block_t<double> > c(n);
+    std::vector<solver::vec_t<double> > j_p(n);
+    for (int i=0; i<n; i++) {
+      c[i] = diff_tensor(mag[i], scal_prop[1][i], scal_prop[2][i], scal_prop[3][i]);
+      for (int j=0; j<3; j++) j_p[i][j] = scal_prop[1][i]*electric_curr*mag[i][j];
+    }
+    std::vector<solver::block_t<double> > g, w_l, w_r;
+    face_coeffs(c, pos, width, scheme, g, w_l, w_r);
+
+    // Faces 1..n, the right neighbour of the last is the first cell of the next period
+    cplx q = std::polar(1.0, phase);
+    std::vector<solver::vec_t<cplx> > j_face(n+1);
+    for (int i=0; i<n; i++) {
+      int r = (i+1)%n;
+      cplx q_r = (r == 0) ? q : cplx(1.0);
+      solver::vec_t<double> f_l = solver::mul(w_l[i], j_p[i]);
+      solver::vec_t<double> f_r = solver::mul(w_r[i], j_p[r]);
+      for (int j=0; j<3; j++) {
+        cplx diff = 0.0;
+        for (int k=0; k<3; k++) diff += g[i][3*j+k]*((q_r*dm[r][k])-dm[i][k]);
+        j_face[i+1][j] = f_l[j]+(q_r*f_r[j])-diff;
+      }
+    }
+    for (int j=0; j<3; j++) j_face[0][j] = std::conj(q)*j_face[n][j];
+
+    std::vector<solver::vec_t<cplx> > j_m(n);
+    for (int i=0; i<n; i++) {
+      for (int j=0; j<3; j++) j_m[i][j] = 0.5*(j_face[i][j]+j_face[i+1][j]);
+    }
+    return j_m;
+  }
+
+  // Source term of dm held at dm_left/dm_right on the outer faces
+  std::vector<solver::vec_t<double> > source_boundary(const std::vector<std::vector<double> >& mag,
+                                                      const std::vector<std::vector<double> >& scal_prop,
+                                                      const std::vector<double>& dm_left,
+                                                      const std::vector<double>& dm_right,
+                                                      const std::vector<double>& width) {
+    int n = mag.size();
+    std::vector<solver::vec_t<double> > b(n);
+    for (int i=0; i<n; i++) b[i].fill(0.0);
+
+    // Diffusive flux across the half cell to each outer face
+    solver::block_t<double> c_left = diff_tensor(mag[0], scal_prop[1][0], scal_prop[2][0], scal_prop[3][0]);
+    solver::block_t<double> c_right = diff_tensor(mag[n-1], scal_prop[1][n-1], scal_prop[2][n-1], scal_prop[3][n-1]);
+    for (int j=0; j<3; j++) {
+      for (int k=0; k<3; k++) {
+        b[0][j]   += 2.0*c_left[3*j+k]*dm_left[k]/(width[0]*width[0]);
+        b[n-1][j] += 2.0*c_right[3*j+k]*dm_right[k]/(width[n-1]*width[n-1]);
+      }
+    }
+    return b;
+  }
 }
@@ -26,16 +26,24 @@
 #define PHYSICS_HPP
 
 #include <vector>
+#include <complex>
+#include <cstdint>
+
+// Block algebra
+#include "solver.hpp"
 
 namespace physics{
   // Calculate the spin current across the system
+  // period > 0 wraps the gradients round a periodic system of that length
   std::vector<std::vector<double> > spin_curr(std::vector<std::vector<double> > spin_accum,
                                               std::vector<std::vector<double> > mag,
                                               std::vector<double> spin_polar_con,
                                               std::vector<double> spin_polar_diff,
                                               std::vector<double> diff,
                                               double electric_curr,
-                                              double stepsize);
+                                              const std::vector<double>& pos,
+                                              int order = 2,
+                                              double period = 0.0);
 
   // Equation of motion for spin accumulation
   std::vector<std::vector<double> > dm_dt(std::vector<std::vector<double> > spin_accum,
@@ -45,7 +53,199 @@ namespace physics{
                                           std::vector<double> dephasing_len,
                                           std::vector<double> spin_flip_len,
                                           std::vector<double> spin_accum_inf,
-                                          double stepsize);
+                                          const std::vector<double>& pos,
+                                          int order = 2,
+                                          double period = 0.0);
+
+  // Langevin term of the equation of motion over a step dt, m += amplitude*sqrt(dt)*xi
+  // with xi standard normal, drawn by counter from (cell, step) under seed
+  void add_noise(std::vector<std::vector<double> >& spin_accum,
+                 const std::vector<double>& amplitude,
+                 double dt,
+                 uint64_t step,
+                 uint32_t seed);
+
+  // Gyromagnetic ratio times mu_0, m/(A s)
+  const double gamma_0 = 2.211e5;
+
+  // Rate of M from the Landau-Lifshitz-Gilbert equation of its direction u = M/|M|,
+  // du/dt = -gamma_0*u x h_eff + alpha*u x du/dt + tau, with the spin-transfer torque
+  // tau of dm: the angular momentum the precession and dephasing terms of dm_dt
+  // take from dm, per saturation magnetization mag_sat (M is fixed for mag_sat = 0)
+  std::vector<double> llg_rate(const std::vector<double>& mag,
+                               const std::vector<double>& dm,
+                               const std::vector<double>& h_eff,
+                               double alpha,
+                               double mag_sat,
+                               double precession_len,
+                               double dephasing_len);
+
+  // Collinear forms of spin_curr and dm_dt, components along a common axis u of
+  // every M, m and J_m (mag holds M.u). The cross products of dm_dt vanish.
+  std::vector<double> spin_curr_collinear(const std::vector<double>& spin_accum,
+                                          const std::vector<double>& mag,
+                                          const std::vector<double>& spin_polar_con,
+                                          const std::vector<double>& spin_polar_diff,
+                                          const std::vector<double>& diff,
+                                          double electric_curr,
+                                          const std::vector<double>& pos,
+                                          int order = 2,
+                                          double period = 0.0);
+
+  std::vector<double> dm_dt_collinear(const std::vector<double>& spin_accum,
+                                      const std::vector<double>& mag,
+                                      const std::vector<double>& spin_curr,
+                                      const std::vector<double>& spin_flip_len,
+                                      const std::vector<double>& spin_accum_inf,
+                                      const std::vector<double>& pos,
+                                      int order = 2,
+                                      double period = 0.0);
+
+  // Diffusion tensor 2D(I - B*B'*MM^T), J_m = B*j_e*M - C*dm_dx
+  solver::block_t<double> diff_tensor(const std::vector<double>& mag,
+                                      double spin_polar_con,
+                                      double spin_polar_diff,
+                                      double diff);
+
+  // Relaxation tensor R, precession + dephasing + spin flip = R*(m - m_inf*M)
+  solver::block_t<double> relax_tensor(const std::vector<double>& mag,
+                                       double precession_len,
+                                       double dephasing_len,
+                                       double spin_flip_len);
+
+  // Zero-thickness interface between cells face and face+1
+  // J_m = g*(dm(face) - dm(face+1)) across it
+  struct iface_t {
+    int face;
+    solver::block_t<double> g;
+  };
+
+  typedef std::complex<double> cplx;
+
+  // Outer face conditions
+  // Periodic is set on both ends, the last cell is followed by the first
+  // Mirror (right end only) is the plane of a mirror-symmetric system, with
+  // dm = -S*dm and J_m = S*J_m at mirrored points for the rotation S
+  enum {bc_equilibrium, bc_zero_flux, bc_transparent, bc_periodic, bc_mirror};
+
+  // Options of the finite-volume discretization
+  struct scheme_t {
+    bool harmonic;                                  // Harmonic-mean face coefficients
+    std::vector<iface_t> iface;                     // Interfaces with a conductance
+    int bc_left, bc_right;                          // Outer face conditions
+    solver::block_t<double> lead_left, lead_right;  // Semi-infinite leads, J_m = B*j_e*M -/+ lead*dm (transparent)
+    solver::block_t<double> mirror;                 // Rotation S taking M to the mirrored M (mirror)
+
+    scheme_t() : harmonic(false), bc_left(bc_equilibrium), bc_right(bc_equilibrium) {
+      lead_left = lead_right = solver::zero<double>();
+      mirror = solver::identity<double>();
+    }
+  };
+
+  // Interface conductance tensor, g along the magnetization and g_mix across it
+  // The axis is taken from the right side, or the left when the right is non-magnetic
+  solver::block_t<double> iface_tensor(const std::vector<double>& mag_l,
+                                       const std::vector<double>& mag_r,
+                                       double g,
+                                       double g_mix);
+
+  // Face between cells l and r, J_m = w_l*B*j_e*M(l) + w_r*B*j_e*M(r) - g*(dm(r)-dm(l))
+  // Arithmetic: coefficients averaged over the centre distance dist
+  // Harmonic: the two half cells in series, J_m and dm continuous at the face
+  void face_coeff(const solver::block_t<double>& c_l,
+                  const solver::block_t<double>& c_r,
+                  double width_l,
+                  double width_r,
+                  double dist,
+                  bool harmonic,
+                  solver::block_t<double>& g,
+                  solver::block_t<double>& w_l,
+                  solver::block_t<double>& w_r);
+
+  // Face between cells l and r split by an interface of conductance g_iface, the two
+  // half cells and the interface in series
+  void iface_coeff(const solver::block_t<double>& c_l,
+                   const solver::block_t<double>& c_r,
+                   double width_l,
+                   double width_r,
+                   const solver::block_t<double>& g_iface,
+                   solver::block_t<double>& g,
+                   solver::block_t<double>& w_l,
+                   solver::block_t<double>& w_r);
+
+  // Outer face conductance from the end cell centre, J_m = B*j_e*M - g*dm on the
+  // left face and B*j_e*M + g*dm on the right
+  // Equilibrium: dm = 0 half a cell out, g = 2C/h
+  // Zero flux: g = 0 (the source is dropped as well)
+  // Transparent: the half cell in series with the lead, g = ((2C/h)^-1 + lead^-1)^-1
+  solver::block_t<double> boundary_coeff(const solver::block_t<double>& c,
+                                         double width,
+                                         int bc,
+                                         const solver::block_t<double>& lead);
+
+  // Linear form of the equation of motion for dm = m - m_inf*M
+  // d(dm)/dt = A*dm + j_e*b
+  // Compact (face-centred spin current) finite-volume discretization on cells
+  // centred at pos with widths width.
+  // Face coefficients are arithmetic or harmonic means (see face_coeff), faces
+  // carrying an interface always take the series form (see iface_coeff), outer
+  // faces follow boundary_coeff.
+  // scal_prop is indexed as in system_t.
+  void assemble(const std::vector<std::vector<double> >& mag,
+                const std::vector<std::vector<double> >& scal_prop,
+                const std::vector<double>& pos,
+                const std::vector<double>& width,
+                solver::btd_t<double>& a,
+                std::vector<solver::vec_t<double> >& b,
+                const scheme_t& scheme = scheme_t());
+
+  // Source term of a current distribution, j_e given per cell
+  std::vector<solver::vec_t<double> > source_current(const std::vector<std::vector<double> >& mag,
+                                                     const std::vector<std::vector<double> >& scal_prop,
+                                                     const std::vector<double>& electric_curr,
+                                                     const std::vector<double>& width,
+                                                     const scheme_t& scheme = scheme_t());
+
+  // Cell-centred spin current of the finite-volume discretization, the mean of the
+  // currents through each cell's faces with dm_left/dm_right on the outer faces
+  std::vector<std::vector<double> > spin_curr_fv(const std::vector<std::vector<double> >& spin_accum,
+                                                 const std::vector<std::vector<double> >& mag,
+                                                 const std::vector<std::vector<double> >& scal_prop,
+                                                 double electric_curr,
+                                                 const std::vector<double>& pos,
+                                                 const std::vector<double>& width,
+                                                 const std::vector<double>& dm_left,
+                                                 const std::vector<double>& dm_right,
+                                                 const scheme_t& scheme);
+
+  // Periodic system in Bloch form, dm(x+L) = exp(i*phase)*dm(x) for a period L,
+  // driven by a current with the same phase between periods
+  // (assemble with the wrap face couplings and source rotated by the phase)
+  void assemble_bloch(const std::vector<std::vector<double> >& mag,
+                      const std::vector<std::vector<double> >& scal_prop,
+                      const std::vector<double>& pos,
+                      const std::vector<double>& width,
+                      double phase,
+                      solver::btd_t<cplx>& a,
+                      std::vector<solver::vec_t<cplx> >& b,
+                      const scheme_t& scheme);
+
+  // Cell-centred spin current of a Bloch solution dm over one period
+  std::vector<solver::vec_t<cplx> > spin_curr_bloch(const std::vector<solver::vec_t<cplx> >& dm,
+                                                    const std::vector<std::vector<double> >& mag,
+                                                    const std::vector<std::vector<double> >& scal_prop,
+                                                    double electric_curr,
+                                                    const std::vector<double>& pos,
+                                                    const std::vector<double>& width,
+                                                    double phase,
+                                                    const scheme_t& scheme);
+
+  // Source term of dm held at dm_left/dm_right on the outer faces instead of equilibrium
+  std::vector<solver::vec_t<double> > source_boundary(const std::vector<std::vector<double> >& mag,
+                                                      const std::vector<std::vector<double> >& scal_prop,
+                                                      const std::vector<double>& dm_left,
+                                                      const std::vector<double>& dm_right,
+                                                      const std::vector<double>& width);
 }
 
 #endif /* PHYSICS_HPP */
@@ -0,0 +1,71 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: random.cpp <CODE>
+//
+//  Counter-based random numbers, Philox4x32-10.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+// Standard libraries
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "random.hpp"
+
+namespace rng {
+  void philox(uint32_t ctr[4], const uint32_t key[2]) {
+    uint32_t k_0 = key[0], k_1 = key[1];
+    for (int r=0; r<10; r++) {
+      philox_round(ctr[0], ctr[1], ctr[2], ctr[3], k_0, k_1);
+      k_0 += weyl_0;
+      k_1 += weyl_1;
+    }
+  }
+
+  // Counter (cell, step), key (seed, 0). The four words of a cell give two pairs
+  // of uniforms in (0, 1), Box-Muller turns them into four normals of which three
+  // are used
+  void normals(uint64_t first, int n, uint64_t step, uint32_t seed, double* out) {
+    #pragma omp parallel for schedule(static)
+    for (int b=0; b<n; b+=block) {
+      int m = std::min(block, n-b);
+      uint32_t x_0[block], x_1[block], x_2[block], x_3[block];
+      for (int c=0; c<m; c++) {
+        uint64_t cell = first+b+c;
+        x_0[c] = uint32_t(cell);
+        x_1[c] = uint32_t(cell >> 32);
+        x_2[c] = uint32_t(step);
+        x_3[c] = uint32_t(step >> 32);
+      }
+
+      // Rounds over the lanes of the block
+      uint32_t k_0 = seed, k_1 = 0;
+      for (int r=0; r<10; r++) {
+        for (int c=0; c<m; c++) philox_round(x_0[c], x_1[c], x_2[c], x_3[c], k_0, k_1);
+        k_0 += weyl_0;
+        k_1 += weyl_1;
+      }
+
+      const double scale = 1.0/4294967296.0;
+      for (int c=0; c<m; c++) {
+        double r_0 = std::sqrt(-2.0*std::log((x_0[c]+0.5)*scale));
+        double r_1 = std::sqrt(-2.0*std::log((x_2[c]+0.5)*scale));
+        double phi_0 = 2.0*M_PI*(x_1[c]+0.5)*scale;
+        double phi_1 = 2.0*M_PI*(x_3[c]+0.5)*scale;
+        double* o = out+(3*(b+c));
+        o[0] = r_0*std::cos(phi_0);
+        o[1] = r_0*std::sin(phi_0);
+        o[2] = r_1*std::cos(phi_1);
+      }
+    }
+  }
+}
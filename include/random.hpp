@@ -0,0 +1,61 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: random.hpp <HEADER>
+//
+//  Counter-based random numbers, Philox4x32-10.
+//
+//  See:
+//
+//  Salmon, J. K., Moraes, M. A., Dror, R. O., & Shaw, D. E.
+//  (2011). Parallel random numbers: as easy as 1, 2, 3.
+//  Proceedings of SC11. http://dx.doi.org/10.1145/2063384.2063405
+//
+//  A draw is a function of its counter and key only, the
+//  numbers of a cell at a step are the same whatever the
+//  order, thread or batch they are generated in. Batches
+//  are generated lane by lane over blocks of cells so the
+//  rounds vectorize.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+
+namespace rng {
+  // Cells per block of a batch
+  const int block = 64;
+
+  // Multipliers and Weyl key increments of Philox4x32
+  const uint32_t mul_0 = 0xD2511F53, mul_1 = 0xCD9E8D57;
+  const uint32_t weyl_0 = 0x9E3779B9, weyl_1 = 0xBB67AE85;
+
+  // One round on the counter words x_0 ... x_3 under the round key (k_0, k_1),
+  // shared by philox and the lanes of normals
+  inline void philox_round(uint32_t& x_0, uint32_t& x_1, uint32_t& x_2, uint32_t& x_3, uint32_t k_0, uint32_t k_1) {
+    uint64_t p_0 = uint64_t(mul_0)*x_0;
+    uint64_t p_1 = uint64_t(mul_1)*x_2;
+    x_0 = uint32_t(p_1 >> 32)^x_1^k_0;
+    x_1 = uint32_t(p_1);
+    x_2 = uint32_t(p_0 >> 32)^x_3^k_1;
+    x_3 = uint32_t(p_0);
+  }
+
+  // Philox4x32-10 of the counter ctr under the key, in place
+  void philox(uint32_t ctr[4], const uint32_t key[2]);
+
+  // Standard normal variates, 3 per cell for the cells first ... first+n-1 at step,
+  // out[3*(c-first)+l]
+  void normals(uint64_t first, int n, uint64_t step, uint32_t seed, double* out);
+}
+
+#endif /* RANDOM_HPP */
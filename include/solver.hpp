@@ -0,0 +1,535 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given 1D system, assumed to be a spin valve/tunnel
+//  junction.
+//
+//  File: solver.hpp <HEADER>
+//
+//  Dense 3x3 block algebra and block-tridiagonal solvers
+//  used by the steady-state and implicit solvers, the
+//  scalar tridiagonal solver of collinear systems and a
+//  small dense solver for the nodes of wire networks.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+#ifndef SOLVER_HPP
+#define SOLVER_HPP
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace solver {
+  // 3x3 block (row-major) and 3-vector
+  template <typename T> using block_t = std::array<T, 9>;
+  template <typename T> using vec_t = std::array<T, 3>;
+
+  template <typename T> block_t<T> zero() {
+    block_t<T> a;
+    a.fill(T(0.0));
+    return a;
+  }
+
+  template <typename T> block_t<T> identity() {
+    block_t<T> a = zero<T>();
+    a[0] = a[4] = a[8] = T(1.0);
+    return a;
+  }
+
+  template <typename T> block_t<T> add(const block_t<T>& a, const block_t<T>& b) {
+    block_t<T> c;
+    for (int i=0; i<9; i++) c[i] = a[i]+b[i];
+    return c;
+  }
+
+  template <typename T> block_t<T> sub(const block_t<T>& a, const block_t<T>& b) {
+    block_t<T> c;
+    for (int i=0; i<9; i++) c[i] = a[i]-b[i];
+    return c;
+  }
+
+  template <typename T> block_t<T> scale(const block_t<T>& a, T s) {
+    block_t<T> c;
+    for (int i=0; i<9; i++) c[i] = s*a[i];
+    return c;
+  }
+
+  // Block-block product
+  template <typename T> block_t<T> mul(const block_t<T>& a, const block_t<T>& b) {
+    block_t<T> c;
+    for (int i=0; i<3; i++) {
+      for (int j=0; j<3; j++) {
+        c[3*i+j] = a[3*i]*b[j] + a[3*i+1]*b[3+j] + a[3*i+2]*b[6+j];
+      }
+    }
+    return c;
+  }
+
+  // Block-vector product
+  template <typename T> vec_t<T> mul(const block_t<T>& a, const vec_t<T>& v) {
+    vec_t<T> c;
+    for (int i=0; i<3; i++) c[i] = a[3*i]*v[0] + a[3*i+1]*v[1] + a[3*i+2]*v[2];
+    return c;
+  }
+
+  template <typename T> vec_t<T> sub(const vec_t<T>& a, const vec_t<T>& b) {
+    vec_t<T> c = {{a[0]-b[0], a[1]-b[1], a[2]-b[2]}};
+    return c;
+  }
+
+  // Inverse by cofactors
+  template <typename T> block_t<T> inv(const block_t<T>& a) {
+    block_t<T> c;
+    c[0] = a[4]*a[8]-a[5]*a[7];
+    c[1] = a[2]*a[7]-a[1]*a[8];
+    c[2] = a[1]*a[5]-a[2]*a[4];
+    c[3] = a[5]*a[6]-a[3]*a[8];
+    c[4] = a[0]*a[8]-a[2]*a[6];
+    c[5] = a[2]*a[3]-a[0]*a[5];
+    c[6] = a[3]*a[7]-a[4]*a[6];
+    c[7] = a[1]*a[6]-a[0]*a[7];
+    c[8] = a[0]*a[4]-a[1]*a[3];
+    T det = a[0]*c[0] + a[1]*c[3] + a[2]*c[6];
+    for (int i=0; i<9; i++) c[i] /= det;
+    return c;
+  }
+
+  // Block-tridiagonal matrix
+  // Row i: lower[i]*x[i-1] + diag[i]*x[i] + upper[i]*x[i+1]
+  // lower[0] and upper[n-1] are unused unless cyclic, where they couple
+  // the first and last rows (x[-1] = x[n-1], x[n] = x[0])
+  template <typename T> struct btd_t {
+    std::vector<block_t<T> > lower;
+    std::vector<block_t<T> > diag;
+    std::vector<block_t<T> > upper;
+    bool cyclic;
+
+    btd_t() : cyclic(false) {}
+
+    void resize(int n) {
+      lower.assign(n, zero<T>());
+      diag.assign(n, zero<T>());
+      upper.assign(n, zero<T>());
+      cyclic = false;
+    }
+
+    int size() const {
+      return diag.size();
+    }
+  };
+
+  // Block-tridiagonal matrix-vector product A*x, rows [first, last] only when given
+  // (zero elsewhere)
+  template <typename T> std::vector<vec_t<T> > apply(const btd_t<T>& a, const std::vector<vec_t<T> >& x, int first = 0, int last = -1) {
+    int n = a.size();
+    if (last < 0) last = n-1;
+    std::vector<vec_t<T> > y(n);
+    for (int i=first; i<=last; i++) {
+      y[i] = mul(a.diag[i], x[i]);
+      if (i > 0 || a.cyclic) {
+        vec_t<T> l = mul(a.lower[i], x[(i+n-1)%n]);
+        for (int j=0; j<3; j++) y[i][j] += l[j];
+      }
+      if (i < n-1 || a.cyclic) {
+        vec_t<T> u = mul(a.upper[i], x[(i+1)%n]);
+        for (int j=0; j<3; j++) y[i][j] += u[j];
+      }
+    }
+    return y;
+  }
+
+  // Gershgorin bound on the spectral radius, the largest absolute row sum
+  template <typename T> double radius(const btd_t<T>& a) {
+    double rho = 0.0;
+    for (int i=0; i<a.size(); i++) {
+      for (int j=0; j<3; j++) {
+        double row = 0.0;
+        for (int k=0; k<3; k++) row += std::abs(a.lower[i][3*j+k])+std::abs(a.diag[i][3*j+k])+std::abs(a.upper[i][3*j+k]);
+        rho = std::max(rho, row);
+      }
+    }
+    return rho;
+  }
+
+  // Block LU (Thomas) factorization of rows [first, last] of a block-tridiagonal matrix
+  template <typename T> struct lu_t {
+    std::vector<block_t<T> > l;      // Elimination multipliers
+    std::vector<block_t<T> > d_inv;  // Inverse pivots
+    std::vector<block_t<T> > upper;  // Upper blocks
+
+    void factor(const btd_t<T>& a, int first, int last) {
+      int n = last-first+1;
+      l.resize(n);
+      d_inv.resize(n);
+      upper.assign(a.upper.begin()+first, a.upper.begin()+last+1);
+
+      d_inv[0] = inv(a.diag[first]);
+      for (int i=1; i<n; i++) {
+        l[i] = mul(a.lower[first+i], d_inv[i-1]);
+        d_inv[i] = inv(sub(a.diag[first+i], mul(l[i], upper[i-1])));
+      }
+    }
+
+    // Solve in place for x[0..n-1], V is a vector or a block of right-hand sides
+    // Batches of n_rhs are stored cell-major, x[i*n_rhs+r], so each factor block is
+    // loaded once for all right-hand sides
+    template <typename V> void solve(V* x, int n_rhs = 1) const {
+      int n = d_inv.size();
+      for (int i=1; i<n; i++) {
+        for (int r=0; r<n_rhs; r++) x[i*n_rhs+r] = sub(x[i*n_rhs+r], mul(l[i], x[(i-1)*n_rhs+r]));
+      }
+      for (int r=0; r<n_rhs; r++) x[(n-1)*n_rhs+r] = mul(d_inv[n-1], x[(n-1)*n_rhs+r]);
+      for (int i=n-2; i>=0; i--) {
+        for (int r=0; r<n_rhs; r++) x[i*n_rhs+r] = mul(d_inv[i], sub(x[i*n_rhs+r], mul(upper[i], x[(i+1)*n_rhs+r])));
+      }
+    }
+  };
+
+  // Block Thomas algorithm, solution returned in rhs
+  template <typename T> void thomas(const btd_t<T>& a, std::vector<vec_t<T> >& rhs) {
+    lu_t<T> lu;
+    lu.factor(a, 0, a.size()-1);
+    lu.solve(rhs.data());
+  }
+
+  // Dense solve of a*x = b, a row-major n x n, by LU with partial pivoting
+  // Solution returned in b
+  template <typename T> void dense_solve(std::vector<T> a, std::vector<T>& b) {
+    int n = b.size();
+    for (int k=0; k<n; k++) {
+      int p = k;
+      for (int i=k+1; i<n; i++) {
+        if (std::abs(a[(i*n)+k]) > std::abs(a[(p*n)+k])) p = i;
+      }
+      if (p != k) {
+        std::swap_ranges(a.begin()+(k*n), a.begin()+((k+1)*n), a.begin()+(p*n));
+        std::swap(b[k], b[p]);
+      }
+      for (int i=k+1; i<n; i++) {
+        T f = a[(i*n)+k]/a[(k*n)+k];
+        for (int j=k; j<n; j++) a[(i*n)+j] -= f*a[(k*n)+j];
+        b[i] -= f*b[k];
+      }
+    }
+    for (int k=n-1; k>=0; k--) {
+      for (int j=k+1; j<n; j++) b[k] -= a[(k*n)+j]*b[j];
+      b[k] /= a[(k*n)+k];
+    }
+  }
+
+  // Factorization of a cyclic block-tridiagonal matrix (periodic systems)
+  // The last row is bordered: rows [0, n-2] are factorized as a block-tridiagonal
+  // matrix and x[n-1] follows from the 3x3 Schur complement of the border
+  template <typename T> class cyclic_t {
+  public:
+    void factor(const btd_t<T>& a) {
+      n = a.size();
+      if (n == 1) {
+        s_inv = inv(add(a.diag[0], add(a.lower[0], a.upper[0])));
+        return;
+      }
+      lu.factor(a, 0, n-2);
+
+      // Coupling of rows [0, n-2] to x[n-1], interior^-1 * column
+      z.assign(n-1, zero<T>());
+      z[0] = a.lower[0];
+      z[n-2] = add(z[n-2], a.upper[n-2]);
+      lu.solve(z.data());
+
+      // Coupling of row n-1 to x[0] and x[n-2]
+      f_first = a.upper[n-1];
+      f_last = a.lower[n-1];
+      s_inv = inv(sub(sub(a.diag[n-1], mul(f_first, z[0])), mul(f_last, z[n-2])));
+    }
+
+    // Solve in place for a batch of n_rhs right-hand sides, rhs[cell*n_rhs+r]
+    void solve(std::vector<vec_t<T> >& rhs, int n_rhs = 1) const {
+      if (n == 1) {
+        for (int r=0; r<n_rhs; r++) rhs[r] = mul(s_inv, rhs[r]);
+        return;
+      }
+      lu.solve(rhs.data(), n_rhs);
+      for (int r=0; r<n_rhs; r++) {
+        vec_t<T>& x_last = rhs[(n-1)*n_rhs+r];
+        x_last = mul(s_inv, sub(sub(x_last, mul(f_first, rhs[r])), mul(f_last, rhs[(n-2)*n_rhs+r])));
+        for (int i=0; i<n-1; i++) rhs[i*n_rhs+r] = sub(rhs[i*n_rhs+r], mul(z[i], x_last));
+      }
+    }
+
+  private:
+    int n;
+    lu_t<T> lu;
+    std::vector<block_t<T> > z;
+    block_t<T> f_first, f_last, s_inv;
+  };
+
+  // Scalar tridiagonal matrix, rows and cyclic coupling as btd_t
+  template <typename T> struct tri_t {
+    std::vector<T> lower;
+    std::vector<T> diag;
+    std::vector<T> upper;
+    bool cyclic;
+
+    tri_t() : cyclic(false) {}
+
+    int size() const {
+      return diag.size();
+    }
+  };
+
+  // Component u^T*A*u of each block along a unit axis u
+  // Exact when every block maps u onto itself and its complement onto the complement
+  template <typename T> tri_t<T> project(const btd_t<T>& a, const vec_t<T>& u) {
+    int n = a.size();
+    tri_t<T> t;
+    t.lower.assign(n, T(0));
+    t.diag.assign(n, T(0));
+    t.upper.assign(n, T(0));
+    t.cyclic = a.cyclic;
+    for (int i=0; i<n; i++) {
+      for (int j=0; j<3; j++) {
+        for (int k=0; k<3; k++) {
+          t.lower[i] += u[j]*a.lower[i][3*j+k]*u[k];
+          t.diag[i] += u[j]*a.diag[i][3*j+k]*u[k];
+          t.upper[i] += u[j]*a.upper[i][3*j+k]*u[k];
+        }
+      }
+    }
+    return t;
+  }
+
+  // Tridiagonal matrix-vector product A*x
+  template <typename T> std::vector<T> apply(const tri_t<T>& a, const std::vector<T>& x) {
+    int n = a.size();
+    std::vector<T> y(n);
+    for (int i=0; i<n; i++) {
+      y[i] = a.diag[i]*x[i];
+      if (i > 0 || a.cyclic) y[i] += a.lower[i]*x[(i+n-1)%n];
+      if (i < n-1 || a.cyclic) y[i] += a.upper[i]*x[(i+1)%n];
+    }
+    return y;
+  }
+
+  // Thomas factorization of a scalar tridiagonal matrix
+  // Cyclic matrices are bordered on the last row as in cyclic_t
+  template <typename T> class tri_lu_t {
+  public:
+    void factor(const tri_t<T>& a) {
+      n = a.size();
+      cyclic = a.cyclic;
+      if (cyclic && n == 1) {
+        s_inv = T(1)/(a.diag[0]+a.lower[0]+a.upper[0]);
+        return;
+      }
+      int m = cyclic ? n-1 : n;
+      l.assign(m, T(0));
+      d_inv.resize(m);
+      upper.assign(a.upper.begin(), a.upper.begin()+m);
+      d_inv[0] = T(1)/a.diag[0];
+      for (int i=1; i<m; i++) {
+        l[i] = a.lower[i]*d_inv[i-1];
+        d_inv[i] = T(1)/(a.diag[i]-(l[i]*upper[i-1]));
+      }
+      if (!cyclic) return;
+
+      // Coupling of rows [0, n-2] to x[n-1] and of row n-1 to x[0], x[n-2]
+      z.assign(m, T(0));
+      z[0] = a.lower[0];
+      z[m-1] += a.upper[m-1];
+      interior(z.data(), 1);
+      f_first = a.upper[n-1];
+      f_last = a.lower[n-1];
+      s_inv = T(1)/(a.diag[n-1]-(f_first*z[0])-(f_last*z[m-1]));
+    }
+
+    // Solve in place for a batch of n_rhs right-hand sides, rhs[cell*n_rhs+r]
+    void solve(std::vector<T>& rhs, int n_rhs = 1) const {
+      if (cyclic && n == 1) {
+        for (int r=0; r<n_rhs; r++) rhs[r] *= s_inv;
+        return;
+      }
+      interior(rhs.data(), n_rhs);
+      if (!cyclic) return;
+      for (int r=0; r<n_rhs; r++) {
+        T& x_last = rhs[(n-1)*n_rhs+r];
+        x_last = s_inv*(x_last-(f_first*rhs[r])-(f_last*rhs[(n-2)*n_rhs+r]));
+        for (int i=0; i<n-1; i++) rhs[i*n_rhs+r] -= z[i]*x_last;
+      }
+    }
+
+  private:
+    void interior(T* x, int n_rhs) const {
+      int m = d_inv.size();
+      for (int i=1; i<m; i++) {
+        for (int r=0; r<n_rhs; r++) x[i*n_rhs+r] -= l[i]*x[(i-1)*n_rhs+r];
+      }
+      for (int r=0; r<n_rhs; r++) x[(m-1)*n_rhs+r] *= d_inv[m-1];
+      for (int i=m-2; i>=0; i--) {
+        for (int r=0; r<n_rhs; r++) x[i*n_rhs+r] = d_inv[i]*(x[i*n_rhs+r]-(upper[i]*x[(i+1)*n_rhs+r]));
+      }
+    }
+
+    int n;
+    bool cyclic;
+    std::vector<T> l, d_inv, upper, z;
+    T f_first, f_last, s_inv;
+  };
+
+  // Substructured (Schur complement) factorization of a block-tridiagonal matrix
+  // Separator cells split the matrix into segments whose interiors are eliminated
+  // independently, leaving a block-tridiagonal Schur complement over the separators
+  template <typename T> class schur_t {
+  public:
+    void factor(const btd_t<T>& a, const std::vector<int>& separators) {
+      int n = a.size();
+
+      // Keep separators that leave every segment at least one interior cell
+      sep.clear();
+      for (int i=0; i<separators.size(); i++) {
+        int prev = sep.empty() ? -1 : sep.back();
+        if (separators[i] > prev+1 && separators[i] < n-1) sep.push_back(separators[i]);
+      }
+
+      // Segments between separators
+      int n_seg = sep.size()+1;
+      segs.resize(n_seg);
+      for (int k=0; k<n_seg; k++) {
+        segs[k].left  = (k>0) ? sep[k-1] : -1;
+        segs[k].right = (k<n_seg-1) ? sep[k] : -1;
+        segs[k].first = segs[k].left+1;
+        segs[k].last  = (k<n_seg-1) ? sep[k]-1 : n-1;
+      }
+
+      // Eliminate segment interiors
+      #pragma omp parallel for schedule(dynamic)
+      for (int k=0; k<n_seg; k++) factor_segment(a, segs[k]);
+
+      factor_separators(a);
+    }
+
+    // Refactorize after some rows of a changed, with the same separators
+    // Only segments containing a changed row are eliminated again, the Schur
+    // complement over the separators is rebuilt. Returns the segments redone.
+    int update(const btd_t<T>& a, const std::vector<bool>& changed) {
+      std::vector<int> redo;
+      for (int k=0; k<segs.size(); k++) {
+        if (std::find(changed.begin()+segs[k].first, changed.begin()+segs[k].last+1, true) != changed.begin()+segs[k].last+1) redo.push_back(k);
+      }
+
+      #pragma omp parallel for schedule(dynamic)
+      for (int k=0; k<redo.size(); k++) factor_segment(a, segs[redo[k]]);
+
+      factor_separators(a);
+      return redo.size();
+    }
+
+    // Solve in place for a batch of n_rhs right-hand sides, rhs[cell*n_rhs+r]
+    void solve(std::vector<vec_t<T> >& rhs, int n_rhs = 1) const {
+      int n_seg = segs.size();
+      int n_sep = sep.size();
+
+      // Interior solutions ignoring the separators
+      std::vector<vec_t<T> > y_first(n_seg*n_rhs), y_last(n_seg*n_rhs);
+      #pragma omp parallel for schedule(dynamic)
+      for (int k=0; k<n_seg; k++) {
+        const segment_t& seg = segs[k];
+        std::vector<vec_t<T> > y(rhs.begin()+seg.first*n_rhs, rhs.begin()+(seg.last+1)*n_rhs);
+        seg.lu.solve(y.data(), n_rhs);
+        std::copy(y.begin(), y.begin()+n_rhs, y_first.begin()+k*n_rhs);
+        std::copy(y.end()-n_rhs, y.end(), y_last.begin()+k*n_rhs);
+      }
+
+      // Separator values
+      std::vector<vec_t<T> > x_sep(n_sep*n_rhs);
+      for (int k=0; k<n_sep; k++) {
+        for (int r=0; r<n_rhs; r++) {
+          x_sep[k*n_rhs+r] = sub(sub(rhs[sep[k]*n_rhs+r], mul(sep_lower[k], y_last[k*n_rhs+r])), mul(sep_upper[k], y_first[(k+1)*n_rhs+r]));
+        }
+      }
+      if (n_sep > 0) sep_lu.solve(x_sep.data(), n_rhs);
+
+      // Back-substitute the interiors with the separators known
+      #pragma omp parallel for schedule(dynamic)
+      for (int k=0; k<n_seg; k++) {
+        const segment_t& seg = segs[k];
+        for (int r=0; r<n_rhs; r++) {
+          if (seg.left >= 0) rhs[seg.first*n_rhs+r] = sub(rhs[seg.first*n_rhs+r], mul(seg.l_first, x_sep[(k-1)*n_rhs+r]));
+          if (seg.right >= 0) rhs[seg.last*n_rhs+r] = sub(rhs[seg.last*n_rhs+r], mul(seg.u_last, x_sep[k*n_rhs+r]));
+        }
+        seg.lu.solve(&rhs[seg.first*n_rhs], n_rhs);
+      }
+      for (int k=0; k<n_sep; k++) {
+        std::copy(x_sep.begin()+k*n_rhs, x_sep.begin()+(k+1)*n_rhs, rhs.begin()+sep[k]*n_rhs);
+      }
+    }
+
+  private:
+    struct segment_t {
+      int first, last;                // Interior cells
+      int left, right;                // Separators, -1 at the system ends
+      lu_t<T> lu;                     // Interior factorization
+      block_t<T> l_first, u_last;     // Coupling to the separators
+      block_t<T> wl_first, wl_last;   // Ends of interior^-1 * coupling to left separator
+      block_t<T> wr_first, wr_last;   // Ends of interior^-1 * coupling to right separator
+    };
+
+    void factor_segment(const btd_t<T>& a, segment_t& seg) {
+      int n = seg.last-seg.first+1;
+      seg.lu.factor(a, seg.first, seg.last);
+      seg.l_first = a.lower[seg.first];
+      seg.u_last = a.upper[seg.last];
+      seg.wl_first = seg.wl_last = seg.wr_first = seg.wr_last = zero<T>();
+
+      std::vector<block_t<T> > w(n);
+      if (seg.left >= 0) {
+        std::fill(w.begin(), w.end(), zero<T>());
+        w.front() = seg.l_first;
+        seg.lu.solve(w.data());
+        seg.wl_first = w.front();
+        seg.wl_last = w.back();
+      }
+      if (seg.right >= 0) {
+        std::fill(w.begin(), w.end(), zero<T>());
+        w.back() = seg.u_last;
+        seg.lu.solve(w.data());
+        seg.wr_first = w.front();
+        seg.wr_last = w.back();
+      }
+    }
+
+    // Schur complement over the separators
+    void factor_separators(const btd_t<T>& a) {
+      int n_sep = sep.size();
+      sep_lower.resize(n_sep);
+      sep_upper.resize(n_sep);
+      if (n_sep == 0) return;
+
+      btd_t<T> s;
+      s.resize(n_sep);
+      for (int k=0; k<n_sep; k++) {
+        const segment_t& left = segs[k];
+        const segment_t& right = segs[k+1];
+        sep_lower[k] = a.lower[sep[k]];
+        sep_upper[k] = a.upper[sep[k]];
+
+        s.diag[k] = sub(sub(a.diag[sep[k]], mul(sep_lower[k], left.wr_last)), mul(sep_upper[k], right.wl_first));
+        if (k > 0) s.lower[k] = scale(mul(sep_lower[k], left.wl_last), T(-1.0));
+        if (k < n_sep-1) s.upper[k] = scale(mul(sep_upper[k], right.wr_first), T(-1.0));
+      }
+      sep_lu.factor(s, 0, n_sep-1);
+    }
+
+    std::vector<int> sep;
+    std::vector<segment_t> segs;
+    std::vector<block_t<T> > sep_lower, sep_upper;
+    lu_t<T> sep_lu;
+  };
+}
+
+#endif /* SOLVER_HPP */
@@ -21,12 +21,21 @@
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <iomanip>
 
 // Own headers
 #include "system.hpp"
 #include "material.hpp"
 #include "term.hpp"
 #include "physics.hpp"
+#include "transfer.hpp"
+#include "amr.hpp"
+#include "io.hpp"
+#include "func.hpp"
+#include "grid.hpp"
+#include "network.hpp"
 
 namespace sys{
 
@@ -36,12 +45,37 @@ namespace sys{
   // System constructor
   system_t::system_t() {
     // DOUBLE system parameters, add string flag to track a new parameter
-    params_d_s = {"dx", "dt", "T", "j_e", "t_ramp"};
+    params_d_s = {"dx", "dt", "T", "j_e", "t_ramp", "mesh_grade", "mesh_cells", "amr_grad", "amr_div", "bloch_phase", "t_warm", "width_y", "width_z", "local_margin", "dt_mag", "tol", "dt_max"};
     params_d.resize(params_d_s.size());
+    params_d[5] = 1.2;
+    params_d[6] = 10.0;
+    params_d[15] = 1e-6;
 
     // INTEGER system parameters, add string flag to track a new parameter
-    params_i_s = {"mat_num", "iface", "t_fout"};
+    params_i_s = {"mat_num", "iface", "t_fout", "implicit", "scan_mat", "mesh", "amr_levels", "amr_regrid", "amr_buffer", "order", "repeat", "mirror", "collinear", "grid_levels", "dim", "richardson", "mag_quasistatic", "adaptive", "seed"};
     params_i.resize(params_i_s.size());
+    params_i[7] = 10;
+    params_i[8] = 1;
+    params_i[9] = 2;
+    params_i[10] = 1;
+    params_i[11] = 1;
+    params_i[12] = 1;
+    params_i[13] = 1;
+    params_i[14] = 1;
+    params_i[15] = 2;
+
+    // STRING system parameters, given with their defaults
+    params_s_s = {"mode", "j_e_sweep", "m_left", "m_right", "scan_prop", "scan_values", "scheme", "bc_left", "bc_right", "wire_nodes", "wire_j_e", "wire_area", "ground", "h_ext", "waveform", "waveform_args", "waveform_file", "frequencies"};
+    params_s = {"evolve", "[]", "", "", "", "[]", "central", "open", "open", "[]", "[]", "[]", "[]", "", "ramp", "[]", "", "[]"};
+
+    // No steady-state factorization yet
+    op_valid = false;
+    op_mirror = false;
+    op_first = 0;
+    op_last = -1;
+    op_collinear = false;
+    op_hint = false;
+    op_local = 0;
   }
 
   // Takes a parameter name and value as strings and sets the value
@@ -52,6 +86,11 @@ namespace sys{
       params_d[prop_id-params_d_s.begin()] = std::stod(value_s);
     }
 
+    // Then as a STRING parameter
+    else if ((prop_id = std::find(params_s_s.begin(), params_s_s.end(), property_s)) != params_s_s.end()) {
+      params_s[prop_id-params_s_s.begin()] = value_s;
+    }
+
     // Otherwise attempt to find location of property as string in INTEGER and set value
     else {
       prop_id = std::find(params_i_s.begin(), params_i_s.end(), property_s);
@@ -80,6 +119,8 @@ namespace sys{
 
   // Takes a material ID and property name and sets the value of the property
   void system_t::set_mat_prop(int mat_id, std::string property_s, std::string value_s) {
+    op_valid = false;
+
     // Check if property is a scalar property and set
     auto prop_id = std::find(mat::scal_prop_s.begin(), mat::scal_prop_s.end(), property_s);
     if (prop_id!=mat::scal_prop_s.end()){
@@ -101,6 +142,62 @@ namespace sys{
       materials[mat_id].len_diff = std::stod(value_s);
     }
 
+    // Cell size in the bulk of the material for the graded mesh
+    else if(property_s == "resolution") {
+      materials[mat_id].resolution = std::stod(value_s);
+    }
+
+    // Interface conductances at the lower boundary
+    else if(property_s == "iface_g") {
+      materials[mat_id].iface_g = std::stod(value_s);
+    }
+    else if(property_s == "iface_g_mix") {
+      materials[mat_id].iface_g_mix = std::stod(value_s);
+    }
+
+    // Magnetization profile
+    else if(property_s == "profile") {
+      materials[mat_id].profile = value_s;
+    }
+    else if(property_s == "profile_centre") {
+      materials[mat_id].profile_centre = std::stod(value_s);
+    }
+    else if(property_s == "profile_width") {
+      materials[mat_id].profile_width = std::stod(value_s);
+    }
+    else if(property_s == "chirality") {
+      materials[mat_id].chirality = std::stoi(value_s);
+    }
+
+    // Magnetization dynamics
+    else if(property_s == "alpha") {
+      materials[mat_id].alpha = std::stod(value_s);
+    }
+    else if(property_s == "mag_sat") {
+      materials[mat_id].mag_sat = std::stod(value_s);
+    }
+    else if(property_s == "h_anis") {
+      materials[mat_id].h_anis = std::stod(value_s);
+    }
+
+    // Thermal noise
+    else if(property_s == "noise") {
+      materials[mat_id].noise = std::stod(value_s);
+    }
+
+    // Wire of the network mode
+    else if(property_s == "wire") {
+      materials[mat_id].wire = std::stoi(value_s);
+    }
+
+    // Lateral extent on a 2D/3D grid
+    else if(property_s == "y_bounds") {
+      materials[mat_id].y_bounds = io::io_parse_list(value_s);
+    }
+    else if(property_s == "z_bounds") {
+      materials[mat_id].z_bounds = io::io_parse_list(value_s);
+    }
+
     // Parse magnetization vector
     else if(property_s == "magnetization" || property_s == "mag") {
       std::vector<double> mag(3);
@@ -128,6 +225,15 @@ namespace sys{
       std::cout << " Vector properties" << std::endl;
       std::cout << " ----------------------------" << std::endl;
       std::cout << " Magnetization: " << materials[i].mag[0] << " " << materials[i].mag[1] << " " << materials[i].mag[2] << std::endl;
+      if (materials[i].profile != "") {
+        std::cout << " Profile: " << materials[i].profile << " centre " << materials[i].profile_centre
+                  << " width " << materials[i].profile_width << " chirality " << ((materials[i].chirality < 0) ? -1 : 1) << std::endl;
+      }
+      if (materials[i].noise > 0.0) std::cout << " Thermal noise: " << materials[i].noise << std::endl;
+      if (materials[i].mag_sat > 0.0) {
+        std::cout << " Dynamics: alpha " << materials[i].alpha << " mag_sat " << materials[i].mag_sat
+                  << " h_anis " << materials[i].h_anis << std::endl;
+      }
       std::cout << std::endl;
       std::cout << " Scalar properties" << std::endl;
       std::cout << " ----------------------------" << std::endl;
@@ -139,6 +245,8 @@ namespace sys{
 
   // Initialize system properties by resizing for system length, zeroing and then filling
   void system_t::prop_init () {
+    op_valid = false;
+    op_hint = false;
 
     // Calculate system length
     // Assume materials go left to right
@@ -151,7 +259,8 @@ namespace sys{
       if (materials[i].upper_bound>max_x) max_x = materials[i].upper_bound;
     }
 
-    int system_len = ceil((max_x-min_x)/params_d[0]);
+    mesh_init(min_x, max_x);
+    int system_len = x.size();
 
     // Vector properties
     // -------------------------
@@ -179,27 +288,26 @@ namespace sys{
     // [4] Precession length                      (L_j)
     // [5] Dephasing length                       (L_phi)
     // [6] Spin-flip length                       (L_sf)
-    scal_prop.resize((mat::scal_prop_s.size()), std::vector<double>(system_len));
+    scal_prop.resize(mat::scal_prop_s.size());
 
     // Empty property vector
     for (int i=0; i<scal_prop.size(); i++){
-      std::fill(scal_prop[i].begin(),
-                scal_prop[i].end(),
-                0.0);
+      scal_prop[i].assign(system_len, 0.0);
     }
 
-    // Electrical current
-    double j_e = 0.0;
-
     // Intialise properties from materials
     for (int i=0; i<materials.size(); i++) {
-      int lower_bound = floor(materials[i].lower_bound/params_d[0]);
-      int upper_bound = floor(materials[i].upper_bound/params_d[0]);
+      int lower_bound, upper_bound;
+      cell_range(i, lower_bound, upper_bound);
 
-      // Magnetization
+      // Magnetization, profiles sampled once at the cells. Every 1D solver and the
+      // magnetization dynamics read (and evolve) M per cell.
       std::fill(mag.begin()+lower_bound,
                 mag.begin()+upper_bound+1,
                 materials[i].mag);
+      if (materials[i].profile != "") {
+        for (int k=lower_bound; k<=upper_bound; k++) mag[k] = mat::magnetization(materials[i], x[k]);
+      }
 
       // Scalar properties fill
       for (int j=0; j<materials[i].scal_prop.size(); j++) {
@@ -212,8 +320,94 @@ namespace sys{
 
   }
 
+  // Cell centres and widths
+  // Uniform: cells of width dx, positioned at i*dx
+  // Graded: each material has a bulk cell size, given or set by its shortest decay
+  // length, refined towards the interfaces and growing by mesh_grade per cell
+  void system_t::mesh_init(double min_x, double max_x) {
+    x.clear();
+    h.clear();
+
+    // Lengths on the mesh are snapped to it, 60e-9/1e-10 is 599.99...
+    if (params_i[5] == 0) {
+      int system_len = ceil(((max_x-min_x)/params_d[0])-1e-9);
+      for (int i=0; i<system_len; i++) {
+        x.push_back(i*params_d[0]);
+        h.push_back(params_d[0]);
+      }
+      return;
+    }
+
+    // Bulk cell size, never finer than dx
+    int n = materials.size();
+    std::vector<double> res(n), res_iface(n+1);
+    for (int i=0; i<n; i++) {
+      res[i] = materials[i].resolution;
+      if (res[i] <= 0.0) {
+        transfer::layer_t layer = transfer::make_layer(materials[i], 0.0, 1.0, 0.0);
+        res[i] = 1.0/(std::max(std::abs(layer.k_perp), std::abs(layer.k_par))*params_d[6]);
+      }
+      res[i] = std::max(res[i], params_d[0]);
+    }
+
+    // Interface cell size, the finer neighbour and any diffuse interface
+    for (int i=0; i<=n; i++) {
+      res_iface[i] = std::min(res[std::max(i-1, 0)], res[std::min(i, n-1)]);
+      if (i > 0 && materials[i-1].len_diff > 0.0) res_iface[i] = std::min(res_iface[i], materials[i-1].len_diff/params_d[6]);
+      if (i < n && materials[i].len_diff > 0.0) res_iface[i] = std::min(res_iface[i], materials[i].len_diff/params_d[6]);
+      res_iface[i] = std::max(res_iface[i], params_d[0]);
+    }
+
+    // Materials extend to the start of the next
+    for (int i=0; i<n; i++) {
+      double lower = materials[i].lower_bound;
+      double upper = (i+1<n) ? materials[i+1].lower_bound : max_x;
+
+      // Grow away from both interfaces up to the bulk size
+      std::vector<double> width;
+      double pos = lower;
+      while (pos < upper) {
+        double size = std::min(res[i], std::min(res_iface[i]+(params_d[5]-1.0)*(pos-lower),
+                                                res_iface[i+1]+(params_d[5]-1.0)*(upper-pos)));
+        width.push_back(size);
+        pos += size;
+      }
+      if (width.size() > 1 && pos-upper > 0.5*width.back()) {
+        pos -= width.back();
+        width.pop_back();
+      }
+
+      // Fit to the material exactly
+      double fit = (upper-lower)/(pos-lower);
+      pos = lower;
+      for (int k=0; k<width.size(); k++) {
+        h.push_back(width[k]*fit);
+        x.push_back(pos+(0.5*h.back()));
+        pos += h.back();
+      }
+    }
+  }
+
+  // First and last cell of a material
+  void system_t::cell_range(int mat_id, int& first, int& last) {
+    // Uniform: cells between the bounds, snapped to the mesh as in mesh_init
+    if (params_i[5] == 0) {
+      first = floor((materials[mat_id].lower_bound/params_d[0])+1e-9);
+      last = std::min(int(floor((materials[mat_id].upper_bound/params_d[0])+1e-9)), int(x.size())-1);
+    }
+    // Graded: cells centred before the next material
+    else {
+      first = std::lower_bound(x.begin(), x.end(), materials[mat_id].lower_bound)-x.begin();
+      if (mat_id+1 < materials.size()) last = (std::lower_bound(x.begin(), x.end(), materials[mat_id+1].lower_bound)-x.begin())-1;
+      else last = x.size()-1;
+    }
+  }
+
   // Apply interface conditions to the system
   void system_t::iface_init() {
+    op_valid = false;
+    op_hint = false;
+
     switch(params_i[1]){
 
     // Atomically smooth
@@ -229,17 +423,23 @@ namespace sys{
         // Skip materials without diffuse interface length
         if (materials[i].len_diff <= 0) continue;
 
+        // Graded mesh: ramp by distance from the end cells
+        if (params_i[5] != 0) {
+          iface_graded(i);
+          continue;
+        }
+
         // Number of steps in each interface
         int iface_steps = materials[i].len_diff/params_d[0];
-        int lower_bound = floor(materials[i].lower_bound/params_d[0]);
-        int upper_bound = floor(materials[i].upper_bound/params_d[0]);
+        int lower_bound, upper_bound;
+        cell_range(i, lower_bound, upper_bound);
 
         // Set mag
         for (int k=0; k<iface_steps; k++) {
           // Left
-          mag[lower_bound-iface_steps+k] = materials[i].mag;
+          mag[lower_bound-iface_steps+k] = mat::magnetization(materials[i], x[lower_bound-iface_steps+k]);
           // Right
-          mag[upper_bound+iface_steps-k] = materials[i].mag;
+          mag[upper_bound+iface_steps-k] = mat::magnetization(materials[i], x[upper_bound+iface_steps-k]);
         }
 
         // Forward declare
@@ -284,6 +484,31 @@ namespace sys{
     }
   }
 
+  // Linear interface of material i on a graded mesh
+  // Properties ramp over len_diff outside the material, as on the uniform mesh
+  void system_t::iface_graded(int i) {
+    int lower_bound, upper_bound;
+    cell_range(i, lower_bound, upper_bound);
+
+    for (int j=0; j<materials[i].scal_prop.size(); j++) {
+      double left_step = (i==0) ? materials[i].scal_prop[j] : materials[i].scal_prop[j]-materials[i-1].scal_prop[j];
+      double right_step = (i==materials.size()-1) ? materials[i].scal_prop[j] : materials[i+1].scal_prop[j]-materials[i].scal_prop[j];
+
+      // Left
+      for (int k=lower_bound-1; k>=0 && x[lower_bound]-x[k]<=materials[i].len_diff; k--) {
+        scal_prop[j][k] += left_step*(1.0-((x[lower_bound]-x[k])/materials[i].len_diff));
+      }
+      // Right
+      for (int k=upper_bound+1; k<x.size() && x[k]-x[upper_bound]<=materials[i].len_diff; k++) {
+        scal_prop[j][k] -= right_step*(1.0-((x[k]-x[upper_bound])/materials[i].len_diff));
+      }
+    }
+
+    // Set mag
+    for (int k=lower_bound-1; k>=0 && x[lower_bound]-x[k]<=materials[i].len_diff; k--) mag[k] = mat::magnetization(materials[i], x[k]);
+    for (int k=upper_bound+1; k<x.size() && x[k]-x[upper_bound]<=materials[i].len_diff; k++) mag[k] = mat::magnetization(materials[i], x[k]);
+  }
+
   // Write the system to file
   void system_t::system_out(){
 
@@ -295,7 +520,7 @@ namespace sys{
     for (int i=0; i<scal_prop.front().size(); i++){
 
       // Position
-      out_file  << i*params_d[0] << ' ';
+      out_file  << x[i] << ' ';
 
       // Step over properties
       for (int j=0; j<scal_prop.size(); j++) {
@@ -309,45 +534,643 @@ namespace sys{
     out_file.close();
   }
 
+  // Write spin current and spin accumulation to file
+  // Periodic systems are tiled params_i[10] times
+  void system_t::state_out(std::string filename) {
+    if (period() == 0.0 || params_i[10] <= 1) {
+      state_out(filename, x, j_m, sa);
+      return;
+    }
+    std::vector<double> pos;
+    std::vector<std::vector<double> > j_tile, sa_tile;
+    for (int k=0; k<params_i[10]; k++) {
+      for (int i=0; i<sa.size(); i++) pos.push_back(x[i]+(k*period()));
+      j_tile.insert(j_tile.end(), j_m.begin(), j_m.end());
+      sa_tile.insert(sa_tile.end(), sa.begin(), sa.end());
+    }
+    state_out(filename, pos, j_tile, sa_tile);
+  }
+
+  // Write spin current and spin accumulation on the given cells to file
+  void system_t::state_out(std::string filename,
+                           const std::vector<double>& pos,
+                           const std::vector<std::vector<double> >& j_m,
+                           const std::vector<std::vector<double> >& sa) {
+    std::ofstream myfile;
+    myfile.open(filename);
+
+    // Space loop
+    for(int k=0; k<sa.size(); k++) {
+      myfile << pos[k] << ' ';
+
+      // Spin current dimension loop
+      for (int l=0; l<j_m[k].size(); l++){
+        myfile << j_m[k][l] << ' ';
+      }
+
+      // Spin accumulation dimension loop
+      for (int l=0; l<sa[k].size(); l++) {
+        myfile << sa[k][l] << ' ';
+      }
+      // Next line
+      myfile << std::endl;
+    }
+    myfile.close();
+  }
+
+  // Run the selected mode of operation
+  void system_t::run() {
+    if (params_i[9] != 2 && params_i[9] != 4 && params_i[9] != 6) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Stencil order must be 2, 4 or 6" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    for (int i=7; i<=8; i++) {
+      if (params_s[i] != "open" && params_s[i] != "equilibrium" && params_s[i] != "zero_flux" && params_s[i] != "transparent" && params_s[i] != "periodic") {
+        std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                  << "Unknown boundary condition " << term::bold << params_s[i] << term::reset << std::endl << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    if ((params_s[7] == "periodic") != (params_s[8] == "periodic")) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Periodic boundaries must be set on both ends" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_s[7] == "periodic" && (params_s[2] != "" || params_s[3] != "" || params_i[6] > 0)) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Periodic boundaries do not take m_left, m_right or refinement" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_d[9] != 0.0 && (params_s[7] != "periodic" || (params_s[0] != "steady" && params_s[0] != "scan"))) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "A Bloch phase needs periodic boundaries and the steady or scan mode" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_s[6] != "central" && params_s[6] != "fv") {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Unknown scheme " << term::bold << params_s[6] << term::reset << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    for (int i=0; i<materials.size(); i++) {
+      const std::string& profile = materials[i].profile;
+      if (profile == "") continue;
+      if (profile != "bloch" && profile != "neel" && profile != "helix" && profile != "cycloid") {
+        std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                  << "Unknown profile " << term::bold << profile << term::reset << std::endl << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      if (materials[i].profile_width <= 0.0) {
+        std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                  << "Profiles need a positive profile_width" << std::endl << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (params_i[6] < 0 || params_i[7] < 1 || params_i[8] < 0) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Refinement needs amr_levels >= 0, amr_regrid >= 1 and amr_buffer >= 0" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_i[13] < 1 || params_i[13] > 10) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Grid levels must be between 1 and 10" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_i[14] < 1 || params_i[14] > 3) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Dimension must be 1, 2 or 3" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    wave = waveform();
+    bool noisy = false;
+    for (int i=0; i<materials.size(); i++) noisy = noisy || materials[i].noise > 0.0;
+    if (noisy && (params_i[6] > 0 || params_i[14] > 1 || params_i[17] == 1)) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Thermal noise needs fixed steps in 1D, without refinement" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_i[17] == 1 && params_d[15] <= 0.0) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Adaptive steps need a positive tolerance tol" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_i[17] == 1 && (params_s[0] != "evolve" || params_i[6] > 0 || params_i[13] > 1 || params_i[14] > 1 || params_d[14] > 0.0)) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Adaptive steps need the evolve mode in 1D, without refinement, grid sequencing or magnetization dynamics" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_d[14] < 0.0 || (params_d[14] > 0.0 && (params_d[14] < params_d[1] || std::abs((params_d[14]/params_d[1])-std::round(params_d[14]/params_d[1])) > 1e-9*(params_d[14]/params_d[1])))) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "The magnetization step dt_mag must be a whole multiple of dt" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_d[14] > 0.0 && (params_s[0] != "evolve" || params_i[6] > 0 || params_i[13] > 1 || params_i[14] > 1)) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Magnetization dynamics need the evolve mode in 1D, without refinement or grid sequencing" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (params_i[14] > 1) {
+      evolve_grid();
+      return;
+    }
+
+    if (params_s[0] == "evolve") evolve();
+    else if (params_s[0] == "transfer") steady_transfer();
+    else if (params_s[0] == "network") steady_network();
+    else if (params_s[0] == "richardson") richardson();
+    else if (params_s[0] == "steady") steady();
+    else if (params_s[0] == "sweep") sweep();
+    else if (params_s[0] == "scan") scan();
+    else if (params_s[0] == "quasistatic") quasistatic();
+    else if (params_s[0] == "ac") ac();
+    else {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Unknown mode " << term::bold << params_s[0] << term::reset << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Cells at the material boundaries, used to split the solvers into segments
+  std::vector<int> system_t::separators() {
+    std::vector<int> sep;
+    for (int i=0; i<materials.size(); i++) {
+      int lower_bound, upper_bound;
+      cell_range(i, lower_bound, upper_bound);
+      if (lower_bound > 0 && lower_bound < sa.size()) sep.push_back(lower_bound);
+    }
+    std::sort(sep.begin(), sep.end());
+    return sep;
+  }
+
+  // Interfaces with a conductance at the material boundaries
+  std::vector<physics::iface_t> system_t::ifaces() {
+    std::vector<physics::iface_t> iface;
+    for (int i=0; i<materials.size(); i++) {
+      if (materials[i].iface_g <= 0.0) continue;
+      int lower_bound, upper_bound;
+      cell_range(i, lower_bound, upper_bound);
+      if (lower_bound < 0 || lower_bound >= sa.size()) continue;
+
+      // The first material of a periodic system follows the last
+      int n = sa.size();
+      if (lower_bound == 0 && period() == 0.0) continue;
+      physics::iface_t f;
+      f.face = (lower_bound+n-1)%n;
+      f.g = physics::iface_tensor(mag[f.face], mag[lower_bound], materials[i].iface_g, materials[i].iface_g_mix);
+      iface.push_back(f);
+    }
+    return iface;
+  }
+
+  // The analytic solutions need uniform layers
+  void system_t::uniform_layers() {
+    for (int i=0; i<materials.size(); i++) {
+      if (materials[i].profile == "") continue;
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Magnetization profiles need a mesh, not the transfer or network mode" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Properties of cell i as a material
+  mat::material system_t::cell_material(int i) {
+    mat::material material = materials.front();
+    material.mag = mag[i];
+    for (int j=0; j<scal_prop.size(); j++) material.scal_prop[j] = scal_prop[j][i];
+    return material;
+  }
+
+  // Finite-volume options from the system parameters
+  physics::scheme_t system_t::scheme() {
+    physics::scheme_t scheme;
+    scheme.harmonic = (params_s[6] == "fv");
+    scheme.iface = ifaces();
+
+    // Outer faces, open is at equilibrium for the face-flux form
+    scheme.bc_left = physics::bc_equilibrium;
+    scheme.bc_right = physics::bc_equilibrium;
+    if (params_s[7] == "zero_flux") scheme.bc_left = physics::bc_zero_flux;
+    if (params_s[7] == "transparent") scheme.bc_left = physics::bc_transparent;
+    if (params_s[8] == "zero_flux") scheme.bc_right = physics::bc_zero_flux;
+    if (params_s[8] == "transparent") scheme.bc_right = physics::bc_transparent;
+    if (params_s[7] == "periodic") scheme.bc_left = scheme.bc_right = physics::bc_periodic;
+
+    // A held accumulation fixes the face
+    if (params_s[2] != "") scheme.bc_left = physics::bc_equilibrium;
+    if (params_s[3] != "") scheme.bc_right = physics::bc_equilibrium;
+
+    // Leads continue the end cells
+    if (scheme.bc_left == physics::bc_transparent) scheme.lead_left = transfer::lead_dtn(cell_material(0));
+    if (scheme.bc_right == physics::bc_transparent) scheme.lead_right = transfer::lead_dtn(cell_material(sa.size()-1));
+    return scheme;
+  }
+
+  // Interfaces and boundary conditions need the face-flux form, the central
+  // scheme only has one-sided differences at the ends (or wraps round them)
+  bool system_t::compact() {
+    bool open = (params_s[7] == "open" && params_s[8] == "open") || period() > 0.0;
+    return params_s[6] == "fv" || !ifaces().empty() || !open;
+  }
+
+  // Length of a periodic system, 0 otherwise
+  double system_t::period() {
+    if (params_s[7] != "periodic") return 0.0;
+    return x.back()-x.front()+(0.5*(h.front()+h.back()));
+  }
+
+  // Rotation S with M(L-x) = S*M(x) when the cells, interfaces and boundaries
+  // are mirror-symmetric about the centre of the system. Disabled by
+  // params_i[11] = 0.
+  bool system_t::mirror(solver::block_t<double>& s) {
+    int n = sa.size();
+    if (params_i[11] == 0 || n < 2 || n%2 != 0) return false;
+    if (params_s[7] != params_s[8] || params_s[7] == "periodic" || params_s[2] != "" || params_s[3] != "") return false;
+    for (int i=0; i<n/2; i++) {
+      if (std::abs(h[i]-h[n-1-i]) > 1e-6*h[i]) return false;
+      for (int j=0; j<scal_prop.size(); j++) {
+        if (std::abs(scal_prop[j][i]-scal_prop[j][n-1-i]) > 1e-9*std::abs(scal_prop[j][i])) return false;
+      }
+    }
+
+    // Distinct magnetization pairs of each cell and its image
+    std::vector<std::vector<double> > mag_l, mag_r;
+    for (int i=0; i<n/2; i++) {
+      bool seen = false;
+      for (int k=0; k<mag_l.size() && !seen; k++) seen = (mag_l[k] == mag[i] && mag_r[k] == mag[n-1-i]);
+      if (seen) continue;
+      mag_l.push_back(mag[i]);
+      mag_r.push_back(mag[n-1-i]);
+    }
+    int n_mat = mag_l.size();
+
+    // Identity (parallel), else a half turn S = 2aa^T - I about an axis a
+    const double eps = 1e-9;
+    std::vector<double> a(3, 0.0);
+    bool same = true;
+    for (int k=0; k<n_mat; k++) {
+      std::vector<double> sum(3), diff(3);
+      for (int l=0; l<3; l++) {
+        sum[l] = mag_l[k][l]+mag_r[k][l];
+        diff[l] = mag_l[k][l]-mag_r[k][l];
+      }
+      if (func::dot(diff, diff) > eps) same = false;
+      if (func::dot(sum, sum) > eps && func::dot(diff, diff) > eps && func::dot(a, a) == 0.0) a = sum;
+    }
+    s = solver::identity<double>();
+    if (same) return true;
+
+    // Only parallel and antiparallel pairs, the axis lies along the parallel
+    // ones and across the antiparallel ones
+    for (int k=0; k<n_mat && func::dot(a, a) == 0.0; k++) {
+      if (func::dot(mag_l[k], mag_l[k]) > eps && func::dot(mag_l[k], mag_r[k]) > 0.0) a = mag_l[k];
+    }
+    for (int k=0; k<n_mat && func::dot(a, a) == 0.0; k++) {
+      if (func::dot(mag_l[k], mag_l[k]) <= eps) continue;
+      for (int j=0; j<n_mat && func::dot(a, a) <= eps; j++) a = func::cross(mag_l[k], mag_l[j]);
+      if (func::dot(a, a) <= eps) {
+        std::vector<double> e(3, 0.0);
+        e[std::abs(mag_l[k][0]) < 0.5 ? 0 : 1] = 1.0;
+        a = func::cross(mag_l[k], e);
+      }
+    }
+    double norm = std::sqrt(func::dot(a, a));
+    if (norm == 0.0) return false;
+    for (int j=0; j<3; j++) {
+      for (int k=0; k<3; k++) s[3*j+k] = (2.0*a[j]*a[k]/(norm*norm))-(j==k ? 1.0 : 0.0);
+    }
+
+    // Every image must match
+    for (int k=0; k<n_mat; k++) {
+      for (int j=0; j<3; j++) {
+        double m_j = s[3*j]*mag_l[k][0]+s[3*j+1]*mag_l[k][1]+s[3*j+2]*mag_l[k][2];
+        if (std::abs(m_j-mag_r[k][j]) > eps) return false;
+      }
+    }
+    return mirror_ifaces(s);
+  }
+
+  // Every interface has an image with the conductance S*g*S
+  bool system_t::mirror_ifaces(const solver::block_t<double>& s) {
+    int n = sa.size();
+    std::vector<physics::iface_t> iface = ifaces();
+    for (int k=0; k<iface.size(); k++) {
+      solver::block_t<double> g = solver::mul(s, solver::mul(iface[k].g, s));
+      double scale = 0.0;
+      for (int j=0; j<9; j++) scale = std::max(scale, std::abs(g[j]));
+      bool found = false;
+      for (int l=0; l<iface.size() && !found; l++) {
+        if (iface[l].face != n-2-iface[k].face) continue;
+        found = true;
+        for (int j=0; j<9; j++) {
+          if (std::abs(iface[l].g[j]-g[j]) > 1e-9*scale) found = false;
+        }
+      }
+      if (!found) return false;
+    }
+    return true;
+  }
+
+  // Left half of the system and its scheme, the mirror plane as the right face
+  void system_t::half(const solver::block_t<double>& s,
+                      std::vector<std::vector<double> >& mag_h,
+                      std::vector<std::vector<double> >& scal_prop_h,
+                      std::vector<double>& x_h,
+                      std::vector<double>& h_h,
+                      physics::scheme_t& scheme_h) {
+    int m = sa.size()/2;
+    mag_h.assign(mag.begin(), mag.begin()+m);
+    scal_prop_h.resize(scal_prop.size());
+    for (int j=0; j<scal_prop.size(); j++) scal_prop_h[j].assign(scal_prop[j].begin(), scal_prop[j].begin()+m);
+    x_h.assign(x.begin(), x.begin()+m);
+    h_h.assign(h.begin(), h.begin()+m);
+
+    scheme_h = scheme();
+    scheme_h.bc_right = physics::bc_mirror;
+    scheme_h.mirror = s;
+    std::vector<physics::iface_t> iface;
+    for (int k=0; k<scheme_h.iface.size(); k++) {
+      if (scheme_h.iface[k].face < m) iface.push_back(scheme_h.iface[k]);
+    }
+    scheme_h.iface = iface;
+  }
+
+  // Right half of the state from the left, m = m_inf*M - S*dm and J_m = S*J_m at the images
+  void system_t::unfold(const solver::block_t<double>& s) {
+    int n = sa.size();
+    for (int i=0; i<n/2; i++) {
+      std::vector<double> m_i(3), j_i(3);
+      for (int l=0; l<3; l++) m_i[l] = (2.0*scal_prop[0][i]*mag[i][l])-sa[i][l];
+      for (int j=0; j<3; j++) {
+        sa[n-1-i][j] = s[3*j]*m_i[0]+s[3*j+1]*m_i[1]+s[3*j+2]*m_i[2];
+        j_m[n-1-i][j] = s[3*j]*j_m[i][0]+s[3*j+1]*j_m[i][1]+s[3*j+2]*j_m[i][2];
+      }
+    }
+  }
+
+  // Common axis u of every M, of the held boundary accumulations and, when state
+  // is set, of the current dm. A and b then map u onto u, so m and J_m stay along
+  // it and only their component along u is solved for. Disabled by params_i[12] = 0.
+  bool system_t::collinear(std::vector<double>& u, bool state) {
+    int n = sa.size();
+    if (params_i[12] == 0 || n == 0) return false;
+
+    // The first non-zero vector sets the axis. dm = m - m_inf*M carries the
+    // rounding of the difference, so it is compared on the scale of m_inf*M.
+    double ref_sq = 0.0;
+    for (int k=0; k<n; k++) ref_sq = std::max(ref_sq, pow(scal_prop[0][k], 2)*func::dot(mag[k], mag[k]));
+    u.assign(3, 0.0);
+    u[2] = 1.0;
+    bool found = false;
+    auto along = [&](const std::vector<double>& w, double w_ref) {
+      double w_sq = func::dot(w, w);
+      if (w_sq == 0.0) return true;
+      if (!found) {
+        double norm = std::sqrt(w_sq);
+        for (int l=0; l<3; l++) u[l] = w[l]/norm;
+        found = true;
+        return true;
+      }
+      std::vector<double> c = func::cross(w, u);
+      return func::dot(c, c) <= 1e-24*std::max(w_sq, w_ref);
+    };
+
+    for (int k=0; k<n; k++) {
+      if (!along(mag[k], 0.0)) return false;
+    }
+    std::vector<double> dm_left, dm_right;
+    boundary_dm(dm_left, dm_right);
+    if (!along(dm_left, ref_sq) || !along(dm_right, ref_sq)) return false;
+    for (int k=0; state && k<n; k++) {
+      std::vector<double> dm(3);
+      for (int l=0; l<3; l++) dm[l] = sa[k][l]-(scal_prop[0][k]*mag[k][l]);
+      if (!along(dm, ref_sq)) return false;
+    }
+    return true;
+  }
+
   // Main evolution loop
   void system_t::evolve(){
+    if (params_d[14] > 0.0) {
+      evolve_llg();
+      return;
+    }
+    if (params_i[17] == 1) {
+      evolve_adaptive();
+      return;
+    }
+    if (params_i[13] > 1) {
+      evolve_levels();
+      return;
+    }
+    evolve_steps(0, ceil(params_d[2]/params_d[1]), 1);
+  }
 
-    // Time loop
-    for (int i=0; i<ceil(params_d[2]/params_d[1]); i++) {
+  // Grid sequencing: the warm-up (params_d[10], half the run by default) is
+  // split between grids coarsened by 2^l for l = params_i[13]-1 ... 1, each
+  // started from the state of the one before. Explicit steps grow with the
+  // cell size up to 4^l while the Gershgorin bound of the operator allows,
+  // keeping the stability margin of dt on the fine grid. Output of the coarse
+  // levels is a low-resolution preview, named by the step of the fine dt.
+  void system_t::evolve_levels() {
+    int levels = params_i[13];
+    double dx = params_d[0], dt = params_d[1], cells = params_d[6];
+    int amr_levels = params_i[6];
+    int n_steps = ceil(params_d[2]/dt);
+    double t_warm = (params_d[10] > 0.0) ? params_d[10] : 0.5*params_d[2];
+    int n_warm = std::min(int(t_warm/dt), n_steps);
+
+    // Level boundaries are multiples of the largest step
+    int block = 1 << (2*(levels-1));
+    int share = ((n_warm/(levels-1))/block)*block;
+    if (share == 0) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "The warm-up of " << n_warm << " steps is too short for " << levels
+                << " grid levels, each coarse level needs " << block << " steps" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
 
-      // Ramp electric current
-      double j_e;
-      if ((i*params_d[1])<params_d[4]) j_e = (params_d[3]*i)/(params_d[4]/params_d[1]);
-      else j_e = params_d[3];
+    solver::btd_t<double> a;
+    std::vector<solver::vec_t<double> > b;
+    physics::assemble(mag, scal_prop, x, h, a, b, scheme());
+    double rho_fine = solver::radius(a);
 
-      // Output every params_i[2] timesteps
-      // TODO: Make more efficient using for loops instead of branching
-      if (i%params_i[2]==0){
-        // Output data here
+    int first = 0;
+    for (int l=levels-1; l>=0; l--) {
+      int last = (l > 0) ? std::min(first+share, n_steps) : n_steps;
 
-        // Name file by timestep
-        std::string filename = std::to_string(i)+ ".dat";
-        std::ofstream myfile;
-        myfile.open(filename);
+      // State of the previous level, interpolated onto this one
+      std::vector<double> x_old = x;
+      std::vector<std::vector<double> > dm_old(sa.size(), std::vector<double>(3)), j_m_old = j_m;
+      for (int k=0; k<sa.size(); k++) {
+        for (int j=0; j<3; j++) dm_old[k][j] = sa[k][j]-(scal_prop[0][k]*mag[k][j]);
+      }
+      params_d[0] = dx*(1 << l);
+      params_d[6] = cells/(1 << l);
+      params_i[6] = (l == 0) ? amr_levels : 0;
+      prop_init();
+      iface_init();
+      if (l < levels-1) {
+        std::vector<std::vector<double> > dm = func::interpolate(dm_old, x_old, x);
+        j_m = func::interpolate(j_m_old, x_old, x);
+        for (int k=0; k<sa.size(); k++) {
+          for (int j=0; j<3; j++) sa[k][j] = dm[k][j]+(scal_prop[0][k]*mag[k][j]);
+        }
+      }
 
-        // Space loop
-        for(int k=0; k<sa.size(); k++) {
-          myfile << k*params_d[0] << ' ';
+      // Step of this level
+      int scale = 1;
+      if (l > 0 && params_i[3] != 1) {
+        physics::assemble(mag, scal_prop, x, h, a, b, scheme());
+        double rho = solver::radius(a);
+        while (scale < (1 << (2*l)) && 2*scale*rho <= rho_fine) scale *= 2;
+      }
+      params_d[1] = dt*scale;
 
-          // Spin current dimension loop
-          for (int l=0; l<j_m[k].size(); l++){
-            myfile << j_m[k][l] << ' ';
-          }
+      if (last > first) evolve_steps(first/scale, last/scale, scale);
+      first = last;
+    }
+    params_d[1] = dt;
+  }
 
-          // Spin accumulation dimension loop
-          for (int l=0; l<sa[k].size(); l++) {
-            myfile << sa[k][l] << ' ';
-          }
-          // Next line
-          myfile << std::endl;
-        }
-        myfile.close();
+  // Explicit time loop on a 2D/3D grid, current and output as for the system mesh
+  template <int D>
+  void evolve_domain(grid::domain_t<D>& domain, const std::vector<double>& params_d, const wave::waveform_t& wave, int t_fout) {
+    int n_steps = ceil(params_d[2]/params_d[1]);
+    for (int i=0; i<n_steps; i++) {
+      double j_e = wave.value(i*params_d[1]);
+
+      if (i%t_fout == 0) domain.write(std::to_string(i)+".dat", j_e);
+      domain.step(params_d[1], j_e);
+    }
+  }
+
+  // Evolve on a uniform grid of material boxes (params_i[14] = 2, 3)
+  void system_t::evolve_grid() {
+    int dim = params_i[14];
+    std::string reason;
+    if (params_s[0] != "evolve") reason = "the evolve mode";
+    else if (params_i[3] == 1) reason = "explicit steps";
+    else if (params_i[5] != 0 || params_i[6] > 0 || params_i[13] > 1) reason = "a uniform mesh without refinement or grid sequencing";
+    else if (params_s[2] != "" || params_s[3] != "" || params_s[7] == "periodic") reason = "contacts without held accumulations or periodic boundaries";
+    else if (params_d[11] <= 0.0 || (dim == 3 && params_d[12] <= 0.0)) reason = "positive widths width_y (and width_z)";
+    if (reason != "") {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "A 2D/3D grid needs " << reason << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    for (int i=0; i<materials.size(); i++) {
+      if (materials[i].iface_g > 0.0 || params_i[1] != 0) {
+        std::cout << term::bold << term::fg_yellow << " Interfaces are not applied on the 2D/3D grid"
+                  << term::reset << std::endl;
+        break;
       }
+    }
+
+    // Contacts take the outer conditions of the system mesh
+    physics::scheme_t s;
+    s.harmonic = (params_s[6] == "fv");
+    s.bc_left = scheme().bc_left;
+    s.bc_right = scheme().bc_right;
+    std::vector<double> width = {params_d[11], params_d[12]};
+    if (dim == 2) {
+      grid::domain_t<2> domain(materials, params_d[0], width, s);
+      evolve_domain(domain, params_d, wave, params_i[2]);
+    }
+    else {
+      grid::domain_t<3> domain(materials, params_d[0], width, s);
+      evolve_domain(domain, params_d, wave, params_i[2]);
+    }
+  }
+
+  // Steps [first, last) of params_d[1] from the current state, output named
+  // by step*scale
+  void system_t::evolve_steps(int first, int last, int scale) {
+    if (params_i[6] > 0) {
+      evolve_amr(first, last, scale);
+      return;
+    }
+    // Noise breaks the collinear and mirror symmetries
+    std::vector<double> noise = noise_cells();
+    bool noisy = *std::max_element(noise.begin(), noise.end()) > 0.0;
+    std::vector<double> u;
+    if (!noisy && collinear(u, true)) {
+      evolve_collinear(u, first, last, scale);
+      return;
+    }
+
+    // Backward Euler: (I/dt - A)*dm' = dm/dt + j_e*b
+    // Factorized once, only the source changes with the current ramp
+    solver::btd_t<double> a;
+    std::vector<solver::vec_t<double> > b;
+    solver::schur_t<double> step;
+    solver::cyclic_t<double> step_cyclic;
+    // Explicit steps use the face-flux form unless purely central
+    bool fv = compact();
+
+    // Mirror-symmetric systems starting from a mirrored state are stepped on the
+    // left half, the right half is rebuilt after each step
+    solver::block_t<double> s;
+    bool folded = !noisy && (params_i[3] == 1 || fv) && mirror(s);
+    for (int i=0; folded && i<sa.size()/2; i++) {
+      int k = sa.size()-1-i;
+      for (int j=0; j<3; j++) {
+        double dm_i = 0.0;
+        for (int l=0; l<3; l++) dm_i -= s[3*j+l]*(sa[i][l]-(scal_prop[0][i]*mag[i][l]));
+        if (std::abs((sa[k][j]-(scal_prop[0][k]*mag[k][j]))-dm_i) > 1e-9*(std::abs(dm_i)+scal_prop[0][k])) folded = false;
+      }
+    }
+    int n_op = folded ? sa.size()/2 : sa.size();
+    if (folded) {
+      std::vector<std::vector<double> > mag_h, scal_prop_h;
+      std::vector<double> x_h, h_h;
+      physics::scheme_t scheme_h;
+      half(s, mag_h, scal_prop_h, x_h, h_h, scheme_h);
+      physics::assemble(mag_h, scal_prop_h, x_h, h_h, a, b, scheme_h);
+    }
+    else if (params_i[3] == 1 || fv) physics::assemble(mag, scal_prop, x, h, a, b, scheme());
+    if (params_i[3] == 1) {
+      for (int k=0; k<a.size(); k++) {
+        a.lower[k] = solver::scale(a.lower[k], -1.0);
+        a.upper[k] = solver::scale(a.upper[k], -1.0);
+        a.diag[k] = solver::sub(solver::scale(solver::identity<double>(), 1.0/params_d[1]), a.diag[k]);
+      }
+      std::vector<int> sep = separators();
+      sep.erase(std::remove_if(sep.begin(), sep.end(), [&](int k) {return k >= n_op;}), sep.end());
+      if (a.cyclic) step_cyclic.factor(a);
+      else step.factor(a, sep);
+    }
+
+    // Rows of the explicit step away from equilibrium or with a source, dm stays exactly
+    // zero outside and the range grows by one cell per step
+    int act_lo = 0, act_hi = n_op-1;
+    if (fv && !a.cyclic && !noisy) {
+      act_lo = n_op;
+      act_hi = -1;
+      for (int k=0; k<n_op; k++) {
+        bool on = false;
+        for (int l=0; l<3; l++) on = on || b[k][l] != 0.0 || sa[k][l]-(scal_prop[0][k]*mag[k][l]) != 0.0;
+        if (!on) continue;
+        act_lo = std::min(act_lo, k);
+        act_hi = std::max(act_hi, k);
+      }
+    }
+
+    // Time loop
+    for (int i=first; i<last; i++) {
+
+      // Electric current of the waveform
+      double j_e = wave.value(i*params_d[1]);
+
+      // Output every params_i[2] timesteps
+      // TODO: Make more efficient using for loops instead of branching
+      if ((i*scale)%params_i[2] < scale){
+        // Name file by timestep
+        state_out(std::to_string(i*scale)+ ".dat");
+      }
+
+      // Noise increment of the step, ahead of the deterministic part
+      if (noisy) physics::add_noise(sa, noise, params_d[1], uint64_t(i)*scale, params_i[18]);
 
       std::vector<std::vector<double> > sa_equil = sa;
       // Set spin accumulation across system to equilibrium values scaled by magnetization
@@ -356,7 +1179,43 @@ namespace sys{
       }
 
       // Calculate spin current across the system
-      j_m = physics::spin_curr(sa_equil, mag, scal_prop[1], scal_prop[2], scal_prop[3], j_e, params_d[0]);
+      j_m = spin_current(sa_equil, j_e, std::vector<double>(3, 0.0), std::vector<double>(3, 0.0));
+
+      // Implicit step, the current at the end of the step (its left limit, as in
+      // evolve_adaptive)
+      if (params_i[3] == 1) {
+        double j_end = wave.value(std::nextafter((i+1)*params_d[1], i*params_d[1]));
+        std::vector<solver::vec_t<double> > rhs(n_op);
+        for (int k=0; k<n_op; k++) {
+          for (int l=0; l<3; l++) rhs[k][l] = (sa_equil[k][l]/params_d[1])+(j_end*b[k][l]);
+        }
+        if (a.cyclic) step_cyclic.solve(rhs);
+        else step.solve(rhs);
+        for (int k=0; k<n_op; k++) {
+          for (int l=0; l<3; l++) sa[k][l] = rhs[k][l]+(scal_prop[0][k]*mag[k][l]);
+        }
+        if (folded) unfold(s);
+        continue;
+      }
+
+      // Explicit finite-volume step, d(dm)/dt = A*dm + j_e*b
+      if (fv) {
+        if (act_lo > act_hi) continue;
+        if (!a.cyclic) {
+          act_lo = std::max(act_lo-1, 0);
+          act_hi = std::min(act_hi+1, n_op-1);
+        }
+        std::vector<solver::vec_t<double> > dm(n_op);
+        for (int k=0; k<n_op; k++) {
+          for (int l=0; l<3; l++) dm[k][l] = sa_equil[k][l];
+        }
+        std::vector<solver::vec_t<double> > rate = solver::apply(a, dm, act_lo, act_hi);
+        for (int k=act_lo; k<=act_hi; k++) {
+          for (int l=0; l<3; l++) sa[k][l] += params_d[1]*(rate[k][l]+(j_e*b[k][l]));
+        }
+        if (folded) unfold(s);
+        continue;
+      }
 
       // Calculate time derivative of the spin accumulation
       std::vector<std::vector<double> > dm_dt = physics::dm_dt(sa,
@@ -366,7 +1225,9 @@ namespace sys{
                                                                scal_prop[5],
                                                                scal_prop[6],
                                                                scal_prop[0],
-                                                               params_d[0]);
+                                                               x,
+                                                               params_i[9],
+                                                               period());
 
       // Space loop
       for (int k=0; k<dm_dt.size(); k++) {
@@ -379,4 +1240,1245 @@ namespace sys{
       }
     }
   }
+
+  // Thermal noise amplitude of each cell, later materials overwrite earlier ones
+  std::vector<double> system_t::noise_cells() {
+    int n = sa.size();
+    std::vector<double> noise(n, 0.0);
+    for (int i=0; i<materials.size(); i++) {
+      int lower_bound, upper_bound;
+      cell_range(i, lower_bound, upper_bound);
+      for (int k=std::max(lower_bound, 0); k<=std::min(upper_bound, n-1); k++) noise[k] = materials[i].noise;
+    }
+    return noise;
+  }
+
+  // Current waveform from the system parameters, a table is read from params_s[16]
+  wave::waveform_t system_t::waveform() {
+    const std::string& kind = params_s[14];
+    std::vector<double> args = io::io_parse_list(params_s[15]);
+    int n_min, n_max;
+    if (kind == "ramp" || kind == "table") n_min = n_max = 0;
+    else if (kind == "pulse") {n_min = 2; n_max = 3;}
+    else if (kind == "train") {n_min = 4; n_max = 5;}
+    else if (kind == "sine") {n_min = 1; n_max = 3;}
+    else {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Unknown waveform " << term::bold << kind << term::reset << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (args.size() < n_min || args.size() > n_max) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Waveform " << kind << " takes " << n_min << " to " << n_max << " parameters" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    args.resize(n_max, 0.0);
+
+    // Pulses do not overlap, the rise fits in the width
+    double rise = (kind == "pulse") ? args[2] : ((kind == "train") ? args[4] : 0.0);
+    if ((kind == "pulse" || kind == "train") && (rise < 0.0 || args[1] <= 0.0 || args[1] < rise)) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Pulses need a positive width of at least the rise time" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (kind == "train" && (args[3] < 1.0 || args[2] < args[1]+rise)) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Trains need at least one pulse and a period of at least width + rise" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    std::vector<double> t_tab, j_tab;
+    if (kind == "table") {
+      std::ifstream table(params_s[16]);
+      std::string line;
+      while (std::getline(table, line)) {
+        std::istringstream line_ss(line);
+        double t, j;
+        if (line.find("#") == 0 || !(line_ss >> t >> j)) continue;
+        if (!t_tab.empty() && (t < t_tab.back() || (t_tab.size() > 1 && t == t_tab[t_tab.size()-2]))) {
+          std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                    << "Waveform table times must increase, at most two points per time" << std::endl << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        t_tab.push_back(t);
+        j_tab.push_back(j);
+      }
+      if (t_tab.empty()) {
+        std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                  << "No waveform table in " << term::bold << params_s[16] << term::reset << std::endl << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    return wave::waveform_t(kind, params_d[3], args, params_d[4], t_tab, j_tab);
+  }
+
+  // Adaptive backward Euler for the current waveform
+  // Each step is taken once over dt and as two steps of dt/2. Their difference
+  // is the error, relative to params_d[15] of the largest |m|, and the accepted
+  // state is the extrapolation 2*dm(dt/2) - dm(dt), second order. Steps end on the
+  // waveform edges and on the output times (every params_i[2] steps of dt), so a
+  // pulse is resolved at its edges and crossed in long steps where it is flat.
+  void system_t::evolve_adaptive() {
+    int n = sa.size();
+    solver::btd_t<double> a;
+    std::vector<solver::vec_t<double> > b;
+    physics::assemble(mag, scal_prop, x, h, a, b, scheme());
+    std::vector<int> sep = separators();
+
+    // Factorizations of I/dt - A for the last two step lengths
+    double f_dt[2] = {0.0, 0.0};
+    solver::schur_t<double> f_schur[2];
+    solver::cyclic_t<double> f_cyclic[2];
+    int f_next = 0;
+    auto be = [&](const std::vector<solver::vec_t<double> >& dm, double dt, double j_e) {
+      int f = (f_dt[0] == dt) ? 0 : ((f_dt[1] == dt) ? 1 : -1);
+      if (f < 0) {
+        f = f_next;
+        f_next = 1-f_next;
+        solver::btd_t<double> a_dt = a;
+        for (int k=0; k<n; k++) {
+          a_dt.lower[k] = solver::scale(a.lower[k], -1.0);
+          a_dt.upper[k] = solver::scale(a.upper[k], -1.0);
+          a_dt.diag[k] = solver::sub(solver::scale(solver::identity<double>(), 1.0/dt), a.diag[k]);
+        }
+        if (a.cyclic) f_cyclic[f].factor(a_dt);
+        else f_schur[f].factor(a_dt, sep);
+        f_dt[f] = dt;
+      }
+      std::vector<solver::vec_t<double> > rhs(n);
+      for (int k=0; k<n; k++) {
+        for (int l=0; l<3; l++) rhs[k][l] = (dm[k][l]/dt)+(j_e*b[k][l]);
+      }
+      if (a.cyclic) f_cyclic[f].solve(rhs);
+      else f_schur[f].solve(rhs);
+      return rhs;
+    };
+
+    std::vector<solver::vec_t<double> > dm(n);
+    double m_ref = 0.0;
+    for (int k=0; k<n; k++) {
+      for (int l=0; l<3; l++) dm[k][l] = sa[k][l]-(scal_prop[0][k]*mag[k][l]);
+      m_ref = std::max(m_ref, std::sqrt(func::dot(mag[k], mag[k]))*std::abs(scal_prop[0][k]));
+    }
+
+    double t = 0.0, t_end = params_d[2], dt = params_d[1];
+    double t_out = params_d[1]*params_i[2];
+    int k_out = 0, accepted = 0, rejected = 0;
+    while (true) {
+      // Output on the times of the fixed steps
+      while (k_out*t_out <= t && k_out*t_out < t_end) {
+        double j_e = wave.value(t);
+        std::vector<std::vector<double> > sa_equil(n, std::vector<double>(3));
+        for (int k=0; k<n; k++) {
+          for (int l=0; l<3; l++) {
+            sa_equil[k][l] = dm[k][l];
+            sa[k][l] = dm[k][l]+(scal_prop[0][k]*mag[k][l]);
+          }
+        }
+        j_m = spin_current(sa_equil, j_e, std::vector<double>(3, 0.0), std::vector<double>(3, 0.0));
+        state_out(std::to_string(k_out*params_i[2])+".dat");
+        k_out++;
+      }
+      if (t >= t_end) break;
+
+      // Step, ended on the next edge or output time when it reaches it
+      double t_stop = std::min(std::min(t_end, wave.next_edge(t)), k_out*t_out);
+      double step = dt;
+      if (params_d[16] > 0.0) step = std::min(step, params_d[16]);
+      bool land = (t+(1.001*step) >= t_stop);
+      if (land) step = t_stop-t;
+      double t_half = t+(0.5*step), t_step = land ? t_stop : t+step;
+
+      // Current over each step, the left limit at its end
+      std::vector<solver::vec_t<double> > dm_full = be(dm, step, wave.value(std::nextafter(t_step, t)));
+      std::vector<solver::vec_t<double> > dm_half = be(dm, 0.5*step, wave.value(std::nextafter(t_half, t)));
+      dm_half = be(dm_half, 0.5*step, wave.value(std::nextafter(t_step, t)));
+
+      double err = 0.0, ref = m_ref;
+      for (int k=0; k<n; k++) {
+        for (int l=0; l<3; l++) {
+          err = std::max(err, std::abs(dm_half[k][l]-dm_full[k][l]));
+          ref = std::max(ref, std::abs(dm_half[k][l]));
+        }
+      }
+      double e = (ref > 0.0) ? err/(params_d[15]*ref) : 0.0;
+      if (e <= 1.0) {
+        for (int k=0; k<n; k++) {
+          for (int l=0; l<3; l++) dm[k][l] = (2.0*dm_half[k][l])-dm_full[k][l];
+        }
+        t = t_step;
+        accepted++;
+      }
+      else {
+        rejected++;
+
+        // The step no longer changes t, the tolerance cannot be met
+        if (step <= 1e-12*std::max(t, params_d[1])) {
+          std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                    << "Adaptive step underflow at t = " << t << ", the tolerance cannot be met" << std::endl << std::endl;
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      // Error of the difference grows as dt^2
+      dt = step*std::min(4.0, std::max(0.2, 0.9/std::sqrt(std::max(e, 1e-12))));
+    }
+    for (int k=0; k<n; k++) {
+      for (int l=0; l<3; l++) sa[k][l] = dm[k][l]+(scal_prop[0][k]*mag[k][l]);
+    }
+    std::cout << " Adaptive steps: " << accepted << " (" << rejected << " rejected)" << std::endl;
+  }
+
+  // Magnetization dynamics coupled to the spin accumulation, multirate
+  // mag is held over each magnetization step of dt_mag (params_d[14], a whole
+  // number of dt) while dm takes its steps, or is set to the steady state at the
+  // current of the step (params_i[16] = 1). dm is then held while mag takes a Heun
+  // step in the field h_ext + h_anis*(u.e)e, e the initial direction of the cell.
+  // The equilibrium accumulation m_inf*M follows M.
+  void system_t::evolve_llg() {
+    int n = sa.size();
+    int n_steps = ceil(params_d[2]/params_d[1]);
+    int inner = std::max(1, int(round(params_d[14]/params_d[1])));
+    std::vector<double> h_ext(3, 0.0);
+    if (params_s[13] != "") h_ext = io::io_parse_list(params_s[13]);
+
+    // Cell properties of the dynamics, later materials overwrite earlier ones
+    std::vector<double> alpha(n, 0.0), mag_sat(n, 0.0), h_anis(n, 0.0);
+    for (int i=0; i<materials.size(); i++) {
+      int lower_bound, upper_bound;
+      cell_range(i, lower_bound, upper_bound);
+      for (int k=std::max(lower_bound, 0); k<=std::min(upper_bound, n-1); k++) {
+        alpha[k] = materials[i].alpha;
+        mag_sat[k] = materials[i].mag_sat;
+        h_anis[k] = materials[i].h_anis;
+      }
+    }
+    std::vector<std::vector<double> > axis(n, std::vector<double>(3, 0.0));
+    std::vector<double> len(n);
+    for (int k=0; k<n; k++) {
+      len[k] = std::sqrt(func::dot(mag[k], mag[k]));
+      for (int l=0; len[k] > 0.0 && l<3; l++) axis[k][l] = mag[k][l]/len[k];
+    }
+
+    auto rate = [&](const std::vector<std::vector<double> >& m, const std::vector<std::vector<double> >& dm) {
+      std::vector<std::vector<double> > r(n, std::vector<double>(3, 0.0));
+      for (int k=0; k<n; k++) {
+        if (mag_sat[k] <= 0.0 || len[k] == 0.0) continue;
+        double u_e = func::dot(m[k], axis[k])/len[k];
+        std::vector<double> h_eff(3);
+        for (int l=0; l<3; l++) h_eff[l] = h_ext[l]+(h_anis[k]*u_e*axis[k][l]);
+        r[k] = physics::llg_rate(m[k], dm[k], h_eff, alpha[k], mag_sat[k], scal_prop[4][k], scal_prop[5][k]);
+      }
+      return r;
+    };
+
+    for (int first=0; first<n_steps; first+=inner) {
+      int last = std::min(first+inner, n_steps);
+      for (int i=first; i<last; i++) {
+        if (i%params_i[2] == 0) mag_out("mag_"+std::to_string(i)+".dat");
+      }
+
+      // Spin accumulation with mag held
+      if (params_i[16] == 1) {
+        double j_e = wave.value(first*params_d[1]);
+        std::vector<std::vector<double> > dm_cur, dm_bnd;
+        steady_basis(dm_cur, dm_bnd);
+        std::vector<std::vector<double> > sa_equil(n, std::vector<double>(3));
+        for (int k=0; k<n; k++) {
+          for (int l=0; l<3; l++) {
+            sa_equil[k][l] = (j_e*dm_cur[k][l])+dm_bnd[k][l];
+            sa[k][l] = sa_equil[k][l]+(scal_prop[0][k]*mag[k][l]);
+          }
+        }
+        std::vector<double> dm_left, dm_right;
+        boundary_dm(dm_left, dm_right);
+        j_m = face_current(sa_equil, j_e, dm_left, dm_right);
+        if (op_mirror) unfold(op_s);
+        for (int i=first; i<last; i++) {
+          if (i%params_i[2] == 0) state_out(std::to_string(i)+".dat");
+        }
+      }
+      else evolve_steps(first, last, 1);
+
+      // Magnetization step with dm held
+      double dt = (last-first)*params_d[1];
+      std::vector<std::vector<double> > dm(n, std::vector<double>(3));
+      for (int k=0; k<n; k++) {
+        for (int l=0; l<3; l++) dm[k][l] = sa[k][l]-(scal_prop[0][k]*mag[k][l]);
+      }
+      std::vector<std::vector<double> > r_0 = rate(mag, dm);
+      std::vector<std::vector<double> > mag_p = mag;
+      for (int k=0; k<n; k++) {
+        for (int l=0; l<3; l++) mag_p[k][l] += dt*r_0[k][l];
+      }
+      std::vector<std::vector<double> > r_1 = rate(mag_p, dm);
+      for (int k=0; k<n; k++) {
+        if (mag_sat[k] <= 0.0 || len[k] == 0.0) continue;
+        for (int l=0; l<3; l++) mag[k][l] += 0.5*dt*(r_0[k][l]+r_1[k][l]);
+        double scale = len[k]/std::sqrt(func::dot(mag[k], mag[k]));
+        for (int l=0; l<3; l++) {
+          mag[k][l] *= scale;
+          sa[k][l] = dm[k][l]+(scal_prop[0][k]*mag[k][l]);
+        }
+      }
+      op_valid = false;
+    }
+    mag_out("mag_"+std::to_string(n_steps)+".dat");
+  }
+
+  // Write the magnetization to file
+  void system_t::mag_out(std::string filename) {
+    std::ofstream myfile;
+    myfile.open(filename);
+    for (int k=0; k<mag.size(); k++) {
+      myfile << x[k] << ' ' << mag[k][0] << ' ' << mag[k][1] << ' ' << mag[k][2] << std::endl;
+    }
+    myfile.close();
+  }
+
+  // Evolution of a collinear system, the components along the axis u only
+  // Steps as evolve, the 3-vector state is rebuilt for output
+  void system_t::evolve_collinear(const std::vector<double>& u, int first, int last, int scale) {
+    int n = sa.size();
+    bool fv = compact();
+    bool central = !fv && params_i[3] != 1;
+
+    // m.u, M.u
+    std::vector<double> m(n), c(n), dm(n), j(n);
+    for (int k=0; k<n; k++) {
+      m[k] = func::dot(sa[k], u);
+      c[k] = func::dot(mag[k], u);
+    }
+
+    // Operator along u, backward Euler (1/dt - A)*dm' = dm/dt + j_e*b
+    solver::tri_t<double> a;
+    std::vector<double> b(n);
+    solver::tri_lu_t<double> step;
+    if (!central) {
+      solver::btd_t<double> a_3;
+      std::vector<solver::vec_t<double> > b_3;
+      physics::assemble(mag, scal_prop, x, h, a_3, b_3, scheme());
+      solver::vec_t<double> u_3 = {{u[0], u[1], u[2]}};
+      a = solver::project(a_3, u_3);
+      for (int k=0; k<n; k++) b[k] = (b_3[k][0]*u[0])+(b_3[k][1]*u[1])+(b_3[k][2]*u[2]);
+    }
+    if (params_i[3] == 1) {
+      for (int k=0; k<n; k++) {
+        a.lower[k] = -a.lower[k];
+        a.upper[k] = -a.upper[k];
+        a.diag[k] = (1.0/params_d[1])-a.diag[k];
+      }
+      step.factor(a);
+    }
+
+    // Time loop
+    for (int i=first; i<last; i++) {
+
+      // Electric current of the waveform
+      double j_e = wave.value(i*params_d[1]);
+
+      // Output every params_i[2] timesteps, the spin current is that of the
+      // previous step as in evolve
+      if ((i*scale)%params_i[2] < scale) {
+        for (int k=0; k<n; k++) {
+          for (int l=0; l<3; l++) {
+            sa[k][l] = m[k]*u[l];
+            if (central && i > first) j_m[k][l] = j[k]*u[l];
+          }
+        }
+        state_out(std::to_string(i*scale)+ ".dat");
+      }
+
+      for (int k=0; k<n; k++) dm[k] = m[k]-(scal_prop[0][k]*c[k]);
+
+      // Spin current, every step for the central scheme, else only before output
+      if (central) {
+        j = physics::spin_curr_collinear(dm, c, scal_prop[1], scal_prop[2], scal_prop[3], j_e, x, params_i[9], period());
+      }
+      else if (((i+1)*scale)%params_i[2] < scale) {
+        std::vector<std::vector<double> > dm_3(n, std::vector<double>(3));
+        for (int k=0; k<n; k++) {
+          for (int l=0; l<3; l++) dm_3[k][l] = dm[k]*u[l];
+        }
+        j_m = spin_current(dm_3, j_e, std::vector<double>(3, 0.0), std::vector<double>(3, 0.0));
+      }
+
+      // Implicit step, the current at the end of the step
+      if (params_i[3] == 1) {
+        double j_end = wave.value(std::nextafter((i+1)*params_d[1], i*params_d[1]));
+        std::vector<double> rhs(n);
+        for (int k=0; k<n; k++) rhs[k] = (dm[k]/params_d[1])+(j_end*b[k]);
+        step.solve(rhs);
+        for (int k=0; k<n; k++) m[k] = rhs[k]+(scal_prop[0][k]*c[k]);
+      }
+
+      // Explicit finite-volume step
+      else if (fv) {
+        std::vector<double> rate = solver::apply(a, dm);
+        for (int k=0; k<n; k++) m[k] += params_d[1]*(rate[k]+(j_e*b[k]));
+      }
+
+      // Explicit central step
+      else {
+        std::vector<double> rate = physics::dm_dt_collinear(m, c, j, scal_prop[6], scal_prop[0], x, params_i[9], period());
+        for (int k=0; k<n; k++) m[k] += rate[k]*params_d[1];
+      }
+    }
+
+    for (int k=0; k<n; k++) {
+      for (int l=0; l<3; l++) sa[k][l] = m[k]*u[l];
+    }
+  }
+
+  // Evolution on an adaptively refined grid, explicit with subcycled levels
+  // Output is written on the finest cells covering the system
+  void system_t::evolve_amr(int first, int last, int scale) {
+    amr::hierarchy_t hier(x, h, mag, scal_prop, params_i[6], params_d[7], params_d[8], params_i[8], scheme());
+
+    // Start from the current state
+    std::vector<std::vector<double> > dm(sa.size(), std::vector<double>(3));
+    for (int k=0; k<sa.size(); k++) {
+      for (int l=0; l<3; l++) dm[k][l] = sa[k][l]-(scal_prop[0][k]*mag[k][l]);
+    }
+    hier.set(dm);
+
+    // Time loop
+    for (int i=first; i<last; i++) {
+
+      // Electric current of the waveform
+      double j_e = wave.value(i*params_d[1]);
+
+      // Output every params_i[2] timesteps
+      if ((i*scale)%params_i[2] < scale) {
+        std::vector<double> pos;
+        std::vector<std::vector<double> > m_leaf, j_leaf;
+        hier.leaves(pos, m_leaf, j_leaf);
+        state_out(std::to_string(i*scale)+ ".dat", pos, j_leaf, m_leaf);
+      }
+
+      // Refine and coarsen every params_i[7] timesteps
+      if ((i-first)%params_i[7]==0) hier.regrid();
+
+      hier.step(params_d[1], j_e);
+    }
+
+    // Base grid state, averaged over refined cells
+    hier.base(dm);
+    for (int k=0; k<sa.size(); k++) {
+      for (int l=0; l<3; l++) sa[k][l] = dm[k][l]+(scal_prop[0][k]*mag[k][l]);
+    }
+  }
+
+  // Analytic steady state of the material layers at the final current
+  // Interface grading (len_diff) is not resolved, each material is uniform
+  void system_t::steady_transfer() {
+    uniform_layers();
+    physics::scheme_t bc = scheme();
+    transfer::stack_t stack(materials, params_d[3], bc.bc_left, bc.bc_right);
+
+    // Evaluate on the output grid
+    for (int i=0; i<sa.size(); i++) {
+      stack.eval(x[i], sa[i], j_m[i]);
+    }
+
+    state_out("steady.dat");
+  }
+
+  // Steady state at dx, dx/2 (and dx/4, params_i[15] = 3) extrapolated to dx -> 0
+  // The runs are copies of the parsed system solved concurrently, each written to
+  // richardson_<l>.dat. At the cell centres of the dx grid the two finest runs give
+  //   f = f_fine + (f_fine - f_coarse)/(2^p - 1)
+  // written to richardson.dat, and |f - f_fine| (the error estimate of the finest
+  // run) to richardson_err.dat. The same extrapolation of the integral of dm over
+  // each material is written to richardson_obs.dat. With two runs p is the order of
+  // the scheme. A third run measures the order from the ratio of successive
+  // differences and p is the observed one, a field whose order disagrees with the
+  // scheme is not extrapolated (the finest run and |f_fine - f_coarse| are written),
+  // nor are the points where the difference between the runs does not shrink.
+  void system_t::richardson() {
+    int levels = params_i[15];
+    if (levels < 2 || levels > 3 || params_i[5] != 0) {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "Richardson extrapolation needs 2 or 3 runs on a uniform mesh" << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    std::vector<system_t> runs(levels, *this);
+    #pragma omp parallel for schedule(dynamic)
+    for (int l=0; l<levels; l++) {
+      runs[l].params_d[0] = params_d[0]/(1 << l);
+      runs[l].prop_init();
+      runs[l].iface_init();
+      runs[l].steady("richardson_"+std::to_string(l)+".dat");
+    }
+
+    // Cells of the dx grid covered by every run, field c of J_m then m at their
+    // centres, the mean of the two finer cells either side of the centre
+    int n = sa.size();
+    for (int l=1; l<levels; l++) n = std::min(n, int(runs[l].sa.size())/(1 << l));
+    auto field = [&](int l, int i, int c) {
+      const std::vector<std::vector<double> >& v = (c < 3) ? runs[l].j_m : runs[l].sa;
+      if (l == 0) return v[i][c%3];
+      int k = (i << l)+(1 << (l-1))-1;
+      return 0.5*(v[k][c%3]+v[k+1][c%3]);
+    };
+
+    // Integral of dm over each material
+    std::vector<std::vector<std::vector<double> > > obs(levels, std::vector<std::vector<double> >(materials.size(), std::vector<double>(3, 0.0)));
+    for (int l=0; l<levels; l++) {
+      for (int i=0; i<materials.size(); i++) {
+        int first, last;
+        runs[l].cell_range(i, first, last);
+        for (int k=std::max(first, 0); k<=last; k++) {
+          for (int j=0; j<3; j++) obs[l][i][j] += runs[l].h[k]*(runs[l].sa[k][j]-(runs[l].scal_prop[0][k]*runs[l].mag[k][j]));
+        }
+      }
+    }
+
+    // Order of the scheme. The face-flux operator is second order when the material
+    // bounds lie on cell faces of every run and the face coefficients are harmonic.
+    // Bounds between faces, linear interfaces and arithmetic averages across a jump
+    // are all first order.
+    bool faces = true;
+    for (int i=0; i<materials.size(); i++) {
+      double bound[2] = {materials[i].lower_bound/params_d[0], materials[i].upper_bound/params_d[0]};
+      for (int k=0; k<2; k++) faces = faces && std::abs(bound[k]-std::round(bound[k])) < 1e-9;
+      if (params_i[1] == 1 && materials[i].len_diff > 0.0) faces = false;
+    }
+    double p = (faces && params_s[6] == "fv") ? 2.0 : 1.0;
+
+    // Observed order of J_m and m with three runs (the median over the points that
+    // converge monotonically). A field is only extrapolated at an observed order
+    // within 0.5 of the scheme's, else the finest run is written. J_m of the central
+    // scheme is never extrapolated, the arithmetic face averages leave O(1) errors at
+    // the interfaces.
+    double p_obs[2] = {p, p};
+    bool extrapolate[2] = {params_s[6] == "fv", true};
+    for (int f=0; levels == 3 && f<2; f++) {
+      std::vector<double> order;
+      for (int i=0; i<n; i++) {
+        for (int c=3*f; c<3*(f+1); c++) {
+          double d_01 = field(1, i, c)-field(0, i, c), d_12 = field(2, i, c)-field(1, i, c);
+          if (d_01*d_12 > 0.0) order.push_back(std::log2(d_01/d_12));
+        }
+      }
+      if (order.empty()) {
+        extrapolate[f] = false;
+        continue;
+      }
+      std::nth_element(order.begin(), order.begin()+(order.size()/2), order.end());
+      p_obs[f] = order[order.size()/2];
+      extrapolate[f] = extrapolate[f] && (std::abs(p_obs[f]-p) <= 0.5);
+    }
+
+    int fine = levels-1;
+    std::vector<double> pos(n);
+    std::vector<std::vector<double> > j_ext(n, std::vector<double>(3)), sa_ext = j_ext, j_err = j_ext, sa_err = j_ext;
+    double err_max[2] = {0.0, 0.0};
+    for (int i=0; i<n; i++) {
+      pos[i] = x[i];
+      for (int c=0; c<6; c++) {
+        int f = c/3;
+        // Points whose differences do not shrink over three runs are not asymptotic
+        double diff = field(fine, i, c)-field(fine-1, i, c);
+        bool shrinks = (levels < 3 || std::abs(diff) < std::abs(field(1, i, c)-field(0, i, c)));
+        double ext = field(fine, i, c)+((extrapolate[f] && shrinks) ? diff/(std::pow(2.0, p_obs[f])-1.0) : 0.0);
+        double err = (extrapolate[f] && shrinks) ? std::abs(ext-field(fine, i, c)) : std::abs(diff);
+        if (f == 0) {
+          j_ext[i][c] = ext;
+          j_err[i][c] = err;
+        }
+        else {
+          sa_ext[i][c-3] = ext;
+          sa_err[i][c-3] = err;
+        }
+        err_max[f] = std::max(err_max[f], err);
+      }
+    }
+    state_out("richardson.dat", pos, j_ext, sa_ext);
+    state_out("richardson_err.dat", pos, j_err, sa_err);
+
+    // Integrals of dm follow m
+    double div = extrapolate[1] ? std::pow(2.0, p_obs[1])-1.0 : 1.0;
+    std::ofstream myfile;
+    myfile.open("richardson_obs.dat");
+    for (int i=0; i<materials.size(); i++) {
+      myfile << i << ' ';
+      for (int j=0; j<3; j++) myfile << obs[fine][i][j]+(extrapolate[1] ? (obs[fine][i][j]-obs[fine-1][i][j])/div : 0.0) << ' ';
+      for (int j=0; j<3; j++) myfile << std::abs(obs[fine][i][j]-obs[fine-1][i][j])/div << ' ';
+      myfile << std::endl;
+    }
+    myfile.close();
+
+    std::cout << " Richardson extrapolation over " << levels << " runs" << std::endl;
+    std::cout << " Order of the scheme: " << p << std::endl;
+    if (levels == 3) std::cout << " Observed order (J_m, m): " << p_obs[0] << " " << p_obs[1] << std::endl;
+    const char* name[2] = {"J_m", "m"};
+    for (int f=0; f<2; f++) {
+      if (extrapolate[f]) continue;
+      std::cout << term::bold << term::fg_yellow << " Warning: " << term::reset << name[f]
+                << ((f == 0 && params_s[6] != "fv") ? " of the central scheme is not extrapolated" : " does not converge at the order of the scheme")
+                << ", the finest run is written" << std::endl;
+    }
+    std::cout << " Largest error of the finest run (J_m, m): " << err_max[0] << " " << err_max[1] << std::endl;
+  }
+
+  // Steady state of a network of wires, the materials of each wire layered along it
+  // Writes wire_<k>.dat sampled every dx from the start of the wire, and dm at the
+  // nodes to nodes.dat
+  void system_t::steady_network() {
+    uniform_layers();
+    std::vector<double> nodes = io::io_parse_list(params_s[9]);
+    std::vector<double> j_e = io::io_parse_list(params_s[10]);
+    std::vector<double> area = io::io_parse_list(params_s[11]);
+    std::vector<double> ground = io::io_parse_list(params_s[12]);
+
+    int n_wires = 0;
+    for (int i=0; i<materials.size(); i++) n_wires = std::max(n_wires, materials[i].wire+1);
+    std::vector<network::wire_t> wires(n_wires);
+    for (int i=0; i<materials.size(); i++) {
+      if (materials[i].wire >= 0) wires[materials[i].wire].materials.push_back(materials[i]);
+    }
+
+    int n_nodes = 0;
+    for (int i=0; i<nodes.size(); i++) n_nodes = std::max(n_nodes, int(nodes[i])+1);
+    std::string reason;
+    if (nodes.size() != 2*n_wires) reason = "a first and last node for every wire";
+    else if ((!j_e.empty() && j_e.size() != n_wires) || (!area.empty() && area.size() != n_wires)) reason = "a current and area for every wire (or none)";
+    for (int i=0; i<nodes.size(); i++) {
+      if (nodes[i] < 0 || nodes[i] != std::floor(nodes[i])) reason = "nodes numbered by non-negative integers";
+    }
+    for (int i=0; i<ground.size(); i++) {
+      if (ground[i] < 0 || ground[i] >= n_nodes || ground[i] != std::floor(ground[i])) reason = "ground nodes at the ends of wires";
+    }
+    for (int i=0; i<area.size(); i++) {
+      if (area[i] <= 0.0) reason = "positive wire areas";
+    }
+    for (int k=0; k<n_wires; k++) {
+      if (wires[k].materials.empty()) reason = "materials in every wire";
+    }
+    if (reason != "") {
+      std::cerr << term::bold << term::fg_red << " Error: " << term::reset
+                << "A network needs " << reason << std::endl << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    for (int k=0; k<n_wires; k++) {
+      wires[k].first = nodes[2*k];
+      wires[k].last = nodes[(2*k)+1];
+      wires[k].j_e = j_e.empty() ? params_d[3] : j_e[k];
+      wires[k].area = area.empty() ? 1.0 : area[k];
+    }
+    network::network_t net(wires, n_nodes, std::vector<int>(ground.begin(), ground.end()));
+
+    for (int k=0; k<n_wires; k++) {
+      double x_first = wires[k].materials.front().lower_bound, x_last = wires[k].materials.front().upper_bound;
+      for (int i=0; i<wires[k].materials.size(); i++) {
+        x_first = std::min(x_first, wires[k].materials[i].lower_bound);
+        x_last = std::max(x_last, wires[k].materials[i].upper_bound);
+      }
+      int n = ceil((x_last-x_first)/params_d[0]);
+      std::vector<double> pos(n+1);
+      std::vector<std::vector<double> > j_w(n+1), sa_w(n+1);
+      for (int i=0; i<=n; i++) {
+        pos[i] = std::min(x_first+(i*params_d[0]), x_last);
+        net.eval(k, pos[i], sa_w[i], j_w[i]);
+      }
+      state_out("wire_"+std::to_string(k)+".dat", pos, j_w, sa_w);
+    }
+
+    std::ofstream myfile;
+    myfile.open("nodes.dat");
+    for (int v=0; v<n_nodes; v++) {
+      myfile << v << ' ' << net.nodes()[v][0] << ' ' << net.nodes()[v][1] << ' ' << net.nodes()[v][2] << std::endl;
+    }
+    myfile.close();
+  }
+
+  // Assemble and factorize the steady-state operator, kept until properties change
+  // When only some cells changed (same grid and material boundaries) only the
+  // segments containing them are refactorized
+  void system_t::op_factor() {
+    if (op_valid) return;
+
+    // Only the texture changed, the rows around it are assembled again
+    std::vector<int> sep = separators();
+    std::vector<double> u;
+    if (!mirror(op_s) && !collinear(u, false) && op_update(sep)) {
+      op_mirror = false;
+      op_collinear = false;
+      if (op_hint) op_save(op_hint_lo, op_hint_hi);
+      else op_save();
+      op_hint = false;
+      op_valid = true;
+      return;
+    }
+    op_hint = false;
+
+    // Mirror-symmetric systems are solved on the left half
+    solver::btd_t<double> a;
+    op_mirror = mirror(op_s);
+    if (op_mirror) {
+      std::vector<std::vector<double> > mag_h, scal_prop_h;
+      std::vector<double> x_h, h_h;
+      physics::scheme_t scheme_h;
+      half(op_s, mag_h, scal_prop_h, x_h, h_h, scheme_h);
+      physics::assemble(mag_h, scal_prop_h, x_h, h_h, a, op_b, scheme_h);
+      sep.erase(std::remove_if(sep.begin(), sep.end(), [&](int k) {return k >= a.size();}), sep.end());
+
+      // Source over the whole system, b = -S*b at the images
+      int n = sa.size();
+      op_b.resize(n);
+      for (int i=0; i<n/2; i++) op_b[n-1-i] = solver::mul(solver::scale(op_s, -1.0), op_b[i]);
+    }
+    else {
+      physics::assemble(mag, scal_prop, x, h, a, op_b, scheme());
+    }
+
+    // Every row is new to the last steady solution
+    op_first = 0;
+    op_last = a.size()-1;
+    op_save();
+
+    // Collinear, the scalar operator along the common axis
+    op_collinear = collinear(u, false);
+    if (op_collinear) {
+      op_u = {{u[0], u[1], u[2]}};
+      op_tri.factor(solver::project(a, op_u));
+      op_a = solver::btd_t<double>();
+      op_stale.clear();
+      op_sep.clear();
+      op_valid = true;
+      return;
+    }
+
+    // Periodic, the wrap face couples the ends so the segments are not independent
+    if (a.cyclic) {
+      op_cyclic.factor(a);
+    }
+    else if (a.size() == op_a.size() && sep == op_sep && !op_a.cyclic) {
+      // Rows changed since the last factorization
+      std::vector<bool> changed(a.size());
+      for (int i=0; i<a.size(); i++) {
+        changed[i] = (a.lower[i] != op_a.lower[i]) || (a.diag[i] != op_a.diag[i]) || (a.upper[i] != op_a.upper[i]);
+        if (i < op_stale.size()) changed[i] = changed[i] || op_stale[i];
+      }
+      op_schur.update(a, changed);
+    }
+    else {
+      op_schur.factor(a, sep);
+    }
+
+    op_stale.clear();
+    op_a = a;
+    op_sep = sep;
+    op_valid = true;
+  }
+
+  // Texture, mesh and settings of the last factorization
+  // Only the cells first..last are copied when given, the mesh and settings unchanged
+  void system_t::op_save(int first, int last) {
+    if (last >= 0) {
+      for (int i=first; i<=last; i++) {
+        op_mag[i] = mag[i];
+        for (int p=0; p<scal_prop.size(); p++) op_scal_prop[p][i] = scal_prop[p][i];
+      }
+      op_iface = ifaces();
+      return;
+    }
+    op_mag = mag;
+    op_scal_prop = scal_prop;
+    op_x = x;
+    op_h = h;
+    op_iface = ifaces();
+    op_params_s = params_s;
+  }
+
+  // Refactorize after a change of mag, scal_prop or the interface conductances alone
+  // Rows only see their neighbour cells, so the rows of the changed cells and their
+  // neighbours are assembled over a window one cell wider and copied into op_a, op_b.
+  // Returns false when the full assembly is needed.
+  // With op_hint set only the hinted cells are compared, the mesh is taken as unchanged.
+  bool system_t::op_update(const std::vector<int>& sep) {
+    int n = sa.size();
+    if (op_a.size() != n || op_a.cyclic || sep != op_sep) return false;
+    if (!op_hint && (x != op_x || h != op_h || params_s != op_params_s)) return false;
+    physics::scheme_t scheme_w = scheme();
+    if (scheme_w.iface.size() != op_iface.size()) return false;
+
+    // Changed cells
+    int first = n, last = -1;
+    auto touch = [&](int i) {
+      first = std::min(first, i);
+      last = std::max(last, i);
+    };
+    int c_lo = op_hint ? op_hint_lo : 0, c_hi = op_hint ? op_hint_hi : n-1;
+    for (int i=c_lo; i<=c_hi; i++) {
+      bool same = (mag[i] == op_mag[i]);
+      for (int p=0; same && p<scal_prop.size(); p++) same = (scal_prop[p][i] == op_scal_prop[p][i]);
+      if (!same) touch(i);
+    }
+    for (int k=0; k<scheme_w.iface.size(); k++) {
+      if (scheme_w.iface[k].face != op_iface[k].face) return false;
+      if (scheme_w.iface[k].g != op_iface[k].g) {
+        touch(scheme_w.iface[k].face);
+        touch(scheme_w.iface[k].face+1);
+      }
+    }
+    if (first > last) return true;
+
+    // Rows lo..hi over the cells w_lo..w_hi, the window ends are at equilibrium
+    // unless they are the system ends
+    int lo = std::max(first-1, 0), hi = std::min(last+1, n-1);
+    int w_lo = std::max(lo-1, 0), w_hi = std::min(hi+1, n-1);
+    std::vector<std::vector<double> > mag_w(mag.begin()+w_lo, mag.begin()+w_hi+1);
+    std::vector<std::vector<double> > scal_prop_w(scal_prop.size());
+    for (int p=0; p<scal_prop.size(); p++) scal_prop_w[p].assign(scal_prop[p].begin()+w_lo, scal_prop[p].begin()+w_hi+1);
+    std::vector<double> x_w(x.begin()+w_lo, x.begin()+w_hi+1), h_w(h.begin()+w_lo, h.begin()+w_hi+1);
+    if (w_lo > 0) scheme_w.bc_left = physics::bc_equilibrium;
+    if (w_hi < n-1) scheme_w.bc_right = physics::bc_equilibrium;
+    std::vector<physics::iface_t> iface_w;
+    for (int k=0; k<scheme_w.iface.size(); k++) {
+      physics::iface_t f = scheme_w.iface[k];
+      if (f.face < w_lo || f.face >= w_hi) continue;
+      f.face -= w_lo;
+      iface_w.push_back(f);
+    }
+    scheme_w.iface = iface_w;
+    solver::btd_t<double> a_w;
+    std::vector<solver::vec_t<double> > b_w;
+    physics::assemble(mag_w, scal_prop_w, x_w, h_w, a_w, b_w, scheme_w);
+
+    // The segments are refactorized by the next global solve, a local re-solve
+    // does not need them
+    op_stale.resize(n, false);
+    for (int i=lo; i<=hi; i++) {
+      int k = i-w_lo;
+      bool changed = (a_w.lower[k] != op_a.lower[i]) || (a_w.diag[k] != op_a.diag[i]) || (a_w.upper[k] != op_a.upper[i]);
+      op_stale[i] = op_stale[i] || changed;
+      op_a.lower[i] = a_w.lower[k];
+      op_a.diag[i] = a_w.diag[k];
+      op_a.upper[i] = a_w.upper[k];
+      op_b[i] = b_w[k];
+    }
+    op_first = std::min(op_first, lo);
+    op_last = std::max(op_last, hi);
+    return true;
+  }
+
+  // Solve A*dm = rhs for a batch of n_rhs right-hand sides, rhs[cell*n_rhs+r]
+  void system_t::steady_solve(std::vector<solver::vec_t<double> >& rhs, int n_rhs) {
+    op_factor();
+
+    // Mirror-symmetric, rhs = -S*rhs at the images as for the current and boundary sources
+    int n = rhs.size()/n_rhs;
+    if (op_mirror) rhs.resize((n/2)*n_rhs);
+    if (op_collinear) {
+      std::vector<double> rhs_u(rhs.size());
+      for (int i=0; i<rhs.size(); i++) rhs_u[i] = (rhs[i][0]*op_u[0])+(rhs[i][1]*op_u[1])+(rhs[i][2]*op_u[2]);
+      op_tri.solve(rhs_u, n_rhs);
+      for (int i=0; i<rhs.size(); i++) {
+        for (int l=0; l<3; l++) rhs[i][l] = rhs_u[i]*op_u[l];
+      }
+    }
+    else if (op_a.cyclic) op_cyclic.solve(rhs, n_rhs);
+    else {
+      if (!op_stale.empty()) op_schur.update(op_a, op_stale);
+      op_stale.clear();
+      op_schur.solve(rhs, n_rhs);
+    }
+    if (op_mirror) {
+      rhs.resize(n*n_rhs);
+      for (int i=0; i<n/2; i++) {
+        for (int r=0; r<n_rhs; r++) rhs[(n-1-i)*n_rhs+r] = solver::mul(solver::scale(op_s, -1.0), rhs[i*n_rhs+r]);
+      }
+    }
+  }
+
+  // Boundary accumulation relative to equilibrium, zero unless given
+  void system_t::boundary_dm(std::vector<double>& dm_left, std::vector<double>& dm_right) {
+    int n = sa.size();
+    dm_left.assign(3, 0.0);
+    dm_right.assign(3, 0.0);
+    if (params_s[2] != "") {
+      dm_left = io::io_parse_list(params_s[2]);
+      for (int l=0; l<3; l++) dm_left[l] -= scal_prop[0][0]*mag[0][l];
+    }
+    if (params_s[3] != "") {
+      dm_right = io::io_parse_list(params_s[3]);
+      for (int l=0; l<3; l++) dm_right[l] -= scal_prop[0][n-1]*mag[n-1][l];
+    }
+  }
+
+  // Spin current of dm from the selected scheme, dm_left/dm_right on the outer
+  // faces for the finite-volume scheme
+  // Face currents are used whenever interfaces or boundary conditions are set
+  std::vector<std::vector<double> > system_t::spin_current(const std::vector<std::vector<double> >& dm,
+                                                           double j_e,
+                                                           const std::vector<double>& dm_left,
+                                                           const std::vector<double>& dm_right) {
+    if (compact()) {
+      return physics::spin_curr_fv(dm, mag, scal_prop, j_e, x, h, dm_left, dm_right, scheme());
+    }
+    return physics::spin_curr(dm, mag, scal_prop[1], scal_prop[2], scal_prop[3], j_e, x, params_i[9], period());
+  }
+
+  // Spin current through the faces of the finite-volume operator, for dm from a
+  // steady solve. Unlike spin_current it does not follow params_i[9], so J_m is
+  // conserved across the faces the solve balanced.
+  std::vector<std::vector<double> > system_t::face_current(const std::vector<std::vector<double> >& dm,
+                                                           double j_e,
+                                                           const std::vector<double>& dm_left,
+                                                           const std::vector<double>& dm_right) {
+    return physics::spin_curr_fv(dm, mag, scal_prop, j_e, x, h, dm_left, dm_right, scheme());
+  }
+
+  // Steady-state responses to unit current (dm_cur) and to the boundary accumulation
+  // (dm_bnd), solved together. dm = j_e*dm_cur + dm_bnd
+  void system_t::steady_basis(std::vector<std::vector<double> >& dm_cur, std::vector<std::vector<double> >& dm_bnd) {
+    op_factor();
+
+    std::vector<double> dm_left, dm_right;
+    boundary_dm(dm_left, dm_right);
+    int n = sa.size();
+    std::vector<solver::vec_t<double> > b_bnd = physics::source_boundary(mag, scal_prop, dm_left, dm_right, h);
+
+    // A*dm = -b for both sources in one pass
+    std::vector<solver::vec_t<double> > rhs(2*n);
+    for (int k=0; k<n; k++) {
+      for (int l=0; l<3; l++) {
+        rhs[2*k][l] = -op_b[k][l];
+        rhs[2*k+1][l] = -b_bnd[k][l];
+      }
+    }
+
+    // Local re-solve: rows changed since the last solution, and params_d[13] either
+    // side of them, are solved again with the last solution held beyond. The held
+    // part carries the truncation of every local solve, so every op_local_max-th
+    // solve is global.
+    const int op_local_max = 8;
+    int lo = n, hi = -1;
+    bool local = params_d[13] > 0.0 && !op_mirror && !op_collinear && !op_a.cyclic && op_a.size() == n && op_sol.size() == 2*n && op_local < op_local_max-1;
+    if (local) {
+      for (int k=0; k<n; k++) {
+        if (rhs[2*k] == op_rhs[2*k] && rhs[2*k+1] == op_rhs[2*k+1] && (k < op_first || k > op_last)) continue;
+        lo = std::min(lo, k);
+        hi = std::max(hi, k);
+      }
+      if (lo <= hi) {
+        int first = lo, last = hi;
+        while (lo > 0 && x[first]-x[lo-1] <= params_d[13]) lo--;
+        while (hi < n-1 && x[hi+1]-x[last] <= params_d[13]) hi++;
+      }
+      local = (lo > 0 || hi < n-1);
+    }
+    op_rhs = rhs;
+    if (local) {
+      std::vector<solver::vec_t<double> > dm = op_sol;
+      if (lo <= hi) {
+        int n_w = hi-lo+1;
+        solver::btd_t<double> a_w;
+        a_w.resize(n_w);
+        std::vector<solver::vec_t<double> > rhs_w(2*n_w);
+        for (int i=lo; i<=hi; i++) {
+          a_w.lower[i-lo] = op_a.lower[i];
+          a_w.diag[i-lo] = op_a.diag[i];
+          a_w.upper[i-lo] = op_a.upper[i];
+          for (int r=0; r<2; r++) rhs_w[2*(i-lo)+r] = rhs[2*i+r];
+        }
+        a_w.lower[0] = a_w.upper[n_w-1] = solver::zero<double>();
+        for (int r=0; r<2; r++) {
+          solver::vec_t<double> f_l = {0.0, 0.0, 0.0}, f_r = {0.0, 0.0, 0.0};
+          if (lo > 0) f_l = solver::mul(op_a.lower[lo], op_sol[2*(lo-1)+r]);
+          if (hi < n-1) f_r = solver::mul(op_a.upper[hi], op_sol[2*(hi+1)+r]);
+          for (int l=0; l<3; l++) {
+            rhs_w[r][l] -= f_l[l];
+            rhs_w[2*(n_w-1)+r][l] -= f_r[l];
+          }
+        }
+        solver::schur_t<double> window;
+        window.factor(a_w, std::vector<int>());
+        window.solve(rhs_w, 2);
+        for (int i=0; i<2*n_w; i++) dm[(2*lo)+i] = rhs_w[i];
+      }
+      rhs = dm;
+    }
+    else steady_solve(rhs, 2);
+    op_local = local ? op_local+1 : 0;
+    op_sol = rhs;
+    op_first = n;
+    op_last = -1;
+
+    dm_cur.assign(n, std::vector<double>(3));
+    dm_bnd.assign(n, std::vector<double>(3));
+    for (int k=0; k<n; k++) {
+      for (int l=0; l<3; l++) {
+        dm_cur[k][l] = rhs[2*k][l];
+        dm_bnd[k][l] = rhs[2*k+1][l];
+      }
+    }
+  }
+
+  // Numerical steady state at the final current
+  // Material segments are eliminated independently (Schur complement)
+  void system_t::steady(std::string filename) {
+    if (params_d[9] != 0.0) {
+      steady_bloch(filename);
+      return;
+    }
+    std::vector<std::vector<double> > dm_cur, dm_bnd;
+    steady_basis(dm_cur, dm_bnd);
+
+    // Spin accumulation and spin current
+    std::vector<std::vector<double> > sa_equil(sa.size(), std::vector<double>(3));
+    for (int k=0; k<sa.size(); k++) {
+      for (int l=0; l<3; l++) {
+        sa_equil[k][l] = (params_d[3]*dm_cur[k][l])+dm_bnd[k][l];
+        sa[k][l] = sa_equil[k][l]+(scal_prop[0][k]*mag[k][l]);
+      }
+    }
+    std::vector<double> dm_left, dm_right;
+    boundary_dm(dm_left, dm_right);
+    j_m = face_current(sa_equil, params_d[3], dm_left, dm_right);
+    if (op_mirror) unfold(op_s);
+
+    state_out(filename);
+  }
+
+  // Steady state of a periodic system with a Bloch phase between periods,
+  // dm(x + k*L) = Re(exp(i*k*phase)*u(x)) for the current j_e*cos(k*phase)
+  // One period is solved, the output is tiled params_i[10] times
+  void system_t::steady_bloch(std::string filename) {
+    int n = sa.size();
+    double phase = params_d[9];
+    solver::btd_t<physics::cplx> a;
+    std::vector<solver::vec_t<physics::cplx> > u;
+    physics::assemble_bloch(mag, scal_prop, x, h, phase, a, u, scheme());
+    for (int k=0; k<n; k++) {
+      for (int l=0; l<3; l++) u[k][l] *= -params_d[3];
+    }
+    solver::cyclic_t<physics::cplx> cyclic;
+    cyclic.factor(a);
+    cyclic.solve(u);
+    std::vector<solver::vec_t<physics::cplx> > j_u = physics::spin_curr_bloch(u, mag, scal_prop, params_d[3], x, h, phase, scheme());
+
+    // Tile with the phase of each period
+    std::vector<double> pos;
+    std::vector<std::vector<double> > j_tile, sa_tile;
+    for (int p=0; p<params_i[10]; p++) {
+      physics::cplx q = std::polar(1.0, p*phase);
+      for (int k=0; k<n; k++) {
+        pos.push_back(x[k]+(p*period()));
+        std::vector<double> m_k(3), j_k(3);
+        for (int l=0; l<3; l++) {
+          m_k[l] = (q*u[k][l]).real()+(scal_prop[0][k]*mag[k][l]);
+          j_k[l] = (q*j_u[k][l]).real();
+        }
+        sa_tile.push_back(m_k);
+        j_tile.push_back(j_k);
+      }
+    }
+    for (int k=0; k<n; k++) {
+      sa[k] = sa_tile[k];
+      j_m[k] = j_tile[k];
+    }
+    state_out(filename, pos, j_tile, sa_tile);
+  }
+
+  // Steady state for a list of currents without re-solving
+  // The current only enters as the source j_e*b, so dm = j_e*dm_cur + dm_bnd
+  // and J_m = j_e*J_cur + J_bnd, with the basis solved once
+  void system_t::sweep() {
+    std::vector<double> j_e_list = io::io_parse_list(params_s[1]);
+
+    std::vector<std::vector<double> > dm_cur, dm_bnd;
+    steady_basis(dm_cur, dm_bnd);
+    std::vector<double> dm_left, dm_right;
+    boundary_dm(dm_left, dm_right);
+    std::vector<std::vector<double> > j_m_cur = face_current(dm_cur, 1.0, std::vector<double>(3, 0.0), std::vector<double>(3, 0.0));
+    std::vector<std::vector<double> > j_m_bnd = face_current(dm_bnd, 0.0, dm_left, dm_right);
+
+    // Superpose for each current
+    for (int i=0; i<j_e_list.size(); i++) {
+      for (int k=0; k<sa.size(); k++) {
+        for (int l=0; l<3; l++) {
+          sa[k][l] = (scal_prop[0][k]*mag[k][l])+(j_e_list[i]*dm_cur[k][l])+dm_bnd[k][l];
+          j_m[k][l] = (j_e_list[i]*j_m_cur[k][l])+j_m_bnd[k][l];
+        }
+      }
+      if (op_mirror) unfold(op_s);
+      state_out("sweep_"+std::to_string(i)+".dat");
+    }
+  }
+
+  // Steady state following the current waveform, written at the output steps of
+  // evolve. For a drive slow against the spin relaxation dm follows it adiabatically.
+  // As in sweep the basis is solved once, each time is a superposition.
+  void system_t::quasistatic() {
+    std::vector<std::vector<double> > dm_cur, dm_bnd;
+    steady_basis(dm_cur, dm_bnd);
+    std::vector<double> dm_left, dm_right;
+    boundary_dm(dm_left, dm_right);
+    std::vector<std::vector<double> > j_m_cur = face_current(dm_cur, 1.0, std::vector<double>(3, 0.0), std::vector<double>(3, 0.0));
+    std::vector<std::vector<double> > j_m_bnd = face_current(dm_bnd, 0.0, dm_left, dm_right);
+
+    int n_steps = ceil(params_d[2]/params_d[1]);
+    for (int i=0; i<n_steps; i+=params_i[2]) {
+      double j_e = wave.value(i*params_d[1]);
+      for (int k=0; k<sa.size(); k++) {
+        for (int l=0; l<3; l++) {
+          sa[k][l] = (scal_prop[0][k]*mag[k][l])+(j_e*dm_cur[k][l])+dm_bnd[k][l];
+          j_m[k][l] = (j_e*j_m_cur[k][l])+j_m_bnd[k][l];
+        }
+      }
+      if (op_mirror) unfold(op_s);
+      state_out(std::to_string(i)+".dat");
+    }
+  }
+
+  // Linear response to the current j_e*cos(w*t) at each frequency f (w = 2*pi*f),
+  // dm = Re(u*exp(i*w*t)) with (i*w*I - A)*u = j_e*b. Frequencies are solved in
+  // parallel, ac_<k>.dat holds the amplitude of J_m and m then their phase (rad)
+  void system_t::ac() {
+    std::vector<double> freq = io::io_parse_list(params_s[17]);
+    int n = sa.size();
+    solver::btd_t<double> a;
+    std::vector<solver::vec_t<double> > b;
+    physics::assemble(mag, scal_prop, x, h, a, b, scheme());
+    std::vector<int> sep = separators();
+
+    std::vector<std::vector<solver::vec_t<physics::cplx> > > u(freq.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int f=0; f<freq.size(); f++) {
+      physics::cplx iw(0.0, 2.0*M_PI*freq[f]);
+      solver::btd_t<physics::cplx> a_w;
+      a_w.resize(n);
+      a_w.cyclic = a.cyclic;
+      u[f].resize(n);
+      for (int k=0; k<n; k++) {
+        for (int j=0; j<9; j++) {
+          a_w.lower[k][j] = -a.lower[k][j];
+          a_w.diag[k][j] = ((j%4 == 0) ? iw : 0.0)-a.diag[k][j];
+          a_w.upper[k][j] = -a.upper[k][j];
+        }
+        for (int l=0; l<3; l++) u[f][k][l] = params_d[3]*b[k][l];
+      }
+      if (a.cyclic) {
+        solver::cyclic_t<physics::cplx> cyclic;
+        cyclic.factor(a_w);
+        cyclic.solve(u[f]);
+      }
+      else {
+        solver::schur_t<physics::cplx> schur;
+        schur.factor(a_w, sep);
+        schur.solve(u[f]);
+      }
+    }
+
+    // J_m is linear in (dm, j_e), the real part carries the current
+    std::vector<double> zero(3, 0.0);
+    for (int f=0; f<freq.size(); f++) {
+      std::vector<std::vector<double> > u_re(n, std::vector<double>(3)), u_im(n, std::vector<double>(3));
+      for (int k=0; k<n; k++) {
+        for (int l=0; l<3; l++) {
+          u_re[k][l] = u[f][k][l].real();
+          u_im[k][l] = u[f][k][l].imag();
+        }
+      }
+      std::vector<std::vector<double> > j_re = face_current(u_re, params_d[3], zero, zero);
+      std::vector<std::vector<double> > j_im = face_current(u_im, 0.0, zero, zero);
+
+      std::ofstream myfile;
+      myfile.open("ac_"+std::to_string(f)+".dat");
+      for (int k=0; k<n; k++) {
+        physics::cplx j_k[3], u_k[3];
+        for (int l=0; l<3; l++) {
+          j_k[l] = physics::cplx(j_re[k][l], j_im[k][l]);
+          u_k[l] = u[f][k][l];
+        }
+        myfile << x[k] << ' ';
+        for (int l=0; l<3; l++) myfile << std::abs(j_k[l]) << ' ';
+        for (int l=0; l<3; l++) myfile << std::abs(u_k[l]) << ' ';
+        for (int l=0; l<3; l++) myfile << std::arg(j_k[l]) << ' ';
+        for (int l=0; l<3; l++) myfile << std::arg(u_k[l]) << ' ';
+        myfile << std::endl;
+      }
+      myfile.close();
+    }
+  }
+
+  // Steady state while one material property steps through a list of values
+  // Only the segments of the changed material are refactorized for each value
+  void system_t::scan() {
+    std::vector<double> values = io::io_parse_list(params_s[5]);
+
+    // A scalar property on the uniform mesh only reaches the cells around the
+    // material, those are set again and only their operator rows assembled
+    auto prop_id = std::find(mat::scal_prop_s.begin(), mat::scal_prop_s.end(), params_s[4]);
+    bool local = (prop_id != mat::scal_prop_s.end() && params_i[5] == 0);
+
+    for (int i=0; i<values.size(); i++) {
+      std::ostringstream value_ss;
+      value_ss << std::setprecision(17) << values[i];
+      set_mat_prop(params_i[4], params_s[4], value_ss.str());
+      if (local) scan_cells(params_i[4], prop_id-mat::scal_prop_s.begin());
+      else {
+        prop_init();
+        iface_init();
+      }
+      steady("scan_"+std::to_string(i)+".dat");
+    }
+  }
+
+  // Set scalar property p again where material mat_id reaches on the uniform mesh:
+  // its cells and interfaces, and the interfaces of its neighbours facing it. Every
+  // material is filled again over these cells, in order, as in prop_init and iface_init.
+  void system_t::scan_cells(int mat_id, int p) {
+    int n = x.size();
+    auto ramp = [&](int i) {
+      return (params_i[1] == 1 && materials[i].len_diff > 0) ? int(materials[i].len_diff/params_d[0]) : 0;
+    };
+    int first, last;
+    cell_range(mat_id, first, last);
+    int lo = first-ramp(mat_id), hi = last+ramp(mat_id);
+    if (mat_id > 0 && ramp(mat_id-1) > 0) {
+      cell_range(mat_id-1, first, last);
+      lo = std::min(lo, last+1);
+      hi = std::max(hi, last+ramp(mat_id-1));
+    }
+    if (mat_id < int(materials.size())-1 && ramp(mat_id+1) > 0) {
+      cell_range(mat_id+1, first, last);
+      lo = std::min(lo, first-ramp(mat_id+1));
+      hi = std::max(hi, first-1);
+    }
+    lo = std::max(lo, 0);
+    hi = std::min(hi, n-1);
+
+    std::fill(scal_prop[p].begin()+lo, scal_prop[p].begin()+hi+1, 0.0);
+    for (int i=0; i<materials.size(); i++) {
+      int lower_bound, upper_bound;
+      cell_range(i, lower_bound, upper_bound);
+      for (int k=std::max(lower_bound, lo); k<=std::min(upper_bound, hi); k++) scal_prop[p][k] = materials[i].scal_prop[p];
+    }
+
+    // Linear interfaces
+    for (int i=0; i<materials.size() && params_i[1] == 1; i++) {
+      if (materials[i].len_diff <= 0) continue;
+      int iface_steps = materials[i].len_diff/params_d[0];
+      int lower_bound, upper_bound;
+      cell_range(i, lower_bound, upper_bound);
+      double left_step = (i==0) ? materials[i].scal_prop[p]/iface_steps : (materials[i].scal_prop[p]-materials[i-1].scal_prop[p])/iface_steps;
+      double right_step = (i==materials.size()-1) ? materials[i].scal_prop[p]/iface_steps : (materials[i+1].scal_prop[p]-materials[i].scal_prop[p])/iface_steps;
+      for (int k=0; k<iface_steps; k++) {
+        int l = lower_bound-iface_steps+k, r = upper_bound+iface_steps-k;
+        if (l >= lo && l <= hi) scal_prop[p][l] += (left_step*k);
+        if (r >= lo && r <= hi) scal_prop[p][r] -= (right_step*k);
+      }
+    }
+
+    // The operator only changes over these cells
+    op_hint_lo = op_hint ? std::min(op_hint_lo, lo) : lo;
+    op_hint_hi = op_hint ? std::max(op_hint_hi, hi) : hi;
+    op_hint = true;
+  }
 }
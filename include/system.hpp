@@ -26,6 +26,15 @@
 // Material struct
 #include "material.hpp"
 
+// Block-tridiagonal solvers
+#include "solver.hpp"
+
+// Interfaces
+#include "physics.hpp"
+
+// Current against time
+#include "waveform.hpp"
+
 namespace sys{
 
   class system_t {
@@ -39,11 +48,79 @@ namespace sys{
     void prop_init();
     void iface_init();
     void system_out();
+    void state_out(std::string filename);
+    void state_out(std::string filename,
+                   const std::vector<double>& pos,
+                   const std::vector<std::vector<double> >& j_m,
+                   const std::vector<std::vector<double> >& sa);
+    void run();
     void evolve();
+    void steady_solve(std::vector<solver::vec_t<double> >& rhs, int n_rhs);
+    void steady_basis(std::vector<std::vector<double> >& dm_cur, std::vector<std::vector<double> >& dm_bnd);
+    void steady(std::string filename = "steady.dat");
+    void steady_bloch(std::string filename);
+    void sweep();
+    void scan();
+    void scan_cells(int mat_id, int p);
+    void quasistatic();
+    void ac();
+    void steady_transfer();
+    void steady_network();
+    void richardson();
   private:
+    void mesh_init(double min_x, double max_x);
+    void cell_range(int mat_id, int& first, int& last);
+    void iface_graded(int i);
+    void evolve_levels();
+    void evolve_grid();
+    void evolve_steps(int first, int last, int scale);
+    void evolve_amr(int first, int last, int scale);
+    void evolve_collinear(const std::vector<double>& u, int first, int last, int scale);
+    void evolve_llg();
+    void evolve_adaptive();
+    wave::waveform_t waveform();
+    std::vector<double> noise_cells();
+    void mag_out(std::string filename);
+    void boundary_dm(std::vector<double>& dm_left, std::vector<double>& dm_right);
+    std::vector<std::vector<double> > spin_current(const std::vector<std::vector<double> >& dm,
+                                                   double j_e,
+                                                   const std::vector<double>& dm_left,
+                                                   const std::vector<double>& dm_right);
+    std::vector<std::vector<double> > face_current(const std::vector<std::vector<double> >& dm,
+                                                   double j_e,
+                                                   const std::vector<double>& dm_left,
+                                                   const std::vector<double>& dm_right);
+    std::vector<int> separators();
+    std::vector<physics::iface_t> ifaces();
+    void uniform_layers();
+    mat::material cell_material(int i);
+    physics::scheme_t scheme();
+    bool compact();
+    double period();
+    bool mirror(solver::block_t<double>& s);
+    bool mirror_ifaces(const solver::block_t<double>& s);
+    void half(const solver::block_t<double>& s,
+              std::vector<std::vector<double> >& mag_h,
+              std::vector<std::vector<double> >& scal_prop_h,
+              std::vector<double>& x_h,
+              std::vector<double>& h_h,
+              physics::scheme_t& scheme_h);
+    void unfold(const solver::block_t<double>& s);
+    bool collinear(std::vector<double>& u, bool state);
+    void op_factor();
+    void op_save(int first=0, int last=-1);
+    bool op_update(const std::vector<int>& sep);
+
     // Materials
     std::vector<mat::material> materials;
 
+    // Mesh
+    // --------------------------------------------------
+    // Cell positions
+    // Cell widths
+    std::vector<double> x;
+    std::vector<double> h;
+
     // Vector properties
     // --------------------------------------------------
     // Magnetization
@@ -70,17 +147,106 @@ namespace sys{
     // Integer
     // [0] Number of materials
     // [1] Interface condition
+    // [2] Output interval (timesteps)
+    // [3] Implicit (backward Euler) time stepping
+    // [4] Material changed by the scan mode
+    // [5] Mesh (0: uniform, 1: graded)
+    // [6] Refinement levels for evolve (0: no refinement)
+    // [7] Regrid interval (timesteps)
+    // [8] Refinement buffer (base cells)
+    // [9] Finite-difference stencil order of the gradients (2, 4, 6)
+    // [10] Periods written out for periodic systems
+    // [11] Solve mirror-symmetric systems on half the domain (0: off, 1: on)
+    // [12] Solve collinear systems for the component along the axis (0: off, 1: on)
+    // [13] Grids of the evolve warm-up, coarsened by 2^l (1: no sequencing, at most 10)
+    // [14] Dimension of the grid (1: the system mesh, 2, 3: uniform grid of boxes, evolve only)
+    // [15] Runs of the richardson mode, at dx/2^l (2, 3)
+    // [16] Spin accumulation at each magnetization step (0: dt steps, 1: steady state)
+    // [17] Adaptive implicit steps for evolve, ended on waveform edges (0: off, 1: on)
+    // [18] Seed of the thermal noise
     // --------------------------------------------------
     // Double
     // [0] Space discretization
     // [1] Time discretization
     // [2] Target time
     // [3] Electrical current
+    // [4] Current ramp time
+    // [5] Graded mesh growth ratio per cell
+    // [6] Graded mesh cells per shortest decay length
+    // [7] Refinement threshold on |grad dm|
+    // [8] Refinement threshold on |div J_m|
+    // [9] Bloch phase between periods (periodic steady state)
+    // [10] Warm-up time on the coarse grids (grid sequencing, default T/2)
+    // [11] Width of the grid in y (dim > 1)
+    // [12] Width of the grid in z (dim > 2)
+    // [13] Margin of the local steady re-solve after a texture change (0: global solve)
+    // [14] Magnetization time step of evolve, a multiple of dt (0: mag fixed)
+    // [15] Relative tolerance of the adaptive steps
+    // [16] Largest adaptive step (0: no limit)
     std::vector<int> params_i;
     std::vector<std::string> params_i_s;
 
     std::vector<double> params_d;
     std::vector<std::string> params_d_s;
+
+    // --------------------------------------------------
+    // String
+    // [0] Mode of operation (evolve, steady, sweep, scan, quasistatic, ac, transfer,
+    //     network, richardson)
+    // [1] Currents for the sweep mode, [j_e_0, j_e_1, ...]
+    // [2] Spin accumulation held at the left face, [m_x, m_y, m_z]
+    // [3] Spin accumulation held at the right face, [m_x, m_y, m_z]
+    // [4] Material property changed by the scan mode
+    // [5] Values of the scanned property, [v_0, v_1, ...]
+    // [6] Spatial scheme (central: cell-centred gradients, fv: finite volume with
+    //     harmonic-mean face coefficients)
+    // [7] Left boundary (open, equilibrium, zero_flux, transparent, periodic)
+    // [8] Right boundary
+    // [9] Nodes at the ends of each wire (network mode), [first_0, last_0, first_1, ...]
+    // [10] Current density along each wire, [j_0, j_1, ...] (default j_e on all)
+    // [11] Cross-section of each wire, [A_0, A_1, ...] (default 1)
+    // [12] Nodes held at equilibrium, [n_0, n_1, ...]
+    // [13] Applied field of the magnetization dynamics, [H_x, H_y, H_z] (A/m)
+    // [14] Current waveform (ramp, pulse, train, sine, table), amplitude j_e
+    // [15] Waveform parameters, [a_0, a_1, ...] (see waveform.hpp)
+    // [16] File of the table waveform, lines t j
+    // [17] Frequencies of the ac mode, [f_0, f_1, ...] (Hz)
+    std::vector<std::string> params_s;
+    std::vector<std::string> params_s_s;
+
+    // Steady-state operator d(dm)/dt = A*dm + j_e*b and its factorization
+    // Valid until material or system properties change
+    bool op_valid;
+    solver::btd_t<double> op_a;
+    std::vector<solver::vec_t<double> > op_b;
+    std::vector<int> op_sep;
+    solver::schur_t<double> op_schur;
+    solver::cyclic_t<double> op_cyclic;
+    bool op_mirror;                   // Factorized over the left half, mirror rotation op_s
+    solver::block_t<double> op_s;
+    bool op_collinear;                // Factorized along the common axis op_u only
+    solver::vec_t<double> op_u;
+    solver::tri_lu_t<double> op_tri;
+
+    // Texture, mesh and settings at the last factorization, for updating only the rows
+    // of changed cells, and the rows changed since the last steady solution op_sol
+    // (right-hand sides op_rhs) for a local re-solve
+    std::vector<std::vector<double> > op_mag, op_scal_prop;
+    std::vector<double> op_x, op_h;
+    std::vector<physics::iface_t> op_iface;
+    std::vector<std::string> op_params_s;
+    int op_first, op_last;
+    // Cells changed since op_save, set by scan_cells, the mesh and settings unchanged
+    bool op_hint;
+    int op_hint_lo, op_hint_hi;
+    std::vector<solver::vec_t<double> > op_rhs, op_sol;
+    // Rows of op_a changed since op_schur was factorized, and local re-solves since
+    // the last global one
+    std::vector<bool> op_stale;
+    int op_local;
+
+    // Current of the evolve modes, built from params_s[14..16] by run()
+    wave::waveform_t wave;
   };
 
   extern system_t system;
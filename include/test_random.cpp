@@ -0,0 +1,80 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: test_random.cpp <TEST>
+//
+//  Known-answer tests of the Philox4x32-10 generator, run
+//  with -t. The vectors are those of the reference imple-
+//  mentation (Random123, kat_vectors).
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+// Standard libraries
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+// Unit testing
+#include "catch.hpp"
+
+#include "random.hpp"
+
+namespace {
+  void check_philox(uint32_t c_0, uint32_t c_1, uint32_t c_2, uint32_t c_3, uint32_t k_0, uint32_t k_1,
+                    uint32_t r_0, uint32_t r_1, uint32_t r_2, uint32_t r_3) {
+    uint32_t ctr[4] = {c_0, c_1, c_2, c_3};
+    uint32_t key[2] = {k_0, k_1};
+    rng::philox(ctr, key);
+    CHECK(ctr[0] == r_0);
+    CHECK(ctr[1] == r_1);
+    CHECK(ctr[2] == r_2);
+    CHECK(ctr[3] == r_3);
+  }
+}
+
+TEST_CASE("Philox4x32-10 known answers", "[random]") {
+  check_philox(0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+               0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8);
+  check_philox(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+               0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd);
+  check_philox(0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+               0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1);
+}
+
+// The batched normals are Box-Muller of philox at the counter (cell, step)
+TEST_CASE("Normals follow the generator", "[random]") {
+  const uint64_t step = 0x100000007, first = 0xfffffff0;
+  const uint32_t seed = 12345;
+  const int n = 3*rng::block+5;
+  std::vector<double> out(3*n);
+  rng::normals(first, n, step, seed, out.data());
+
+  const double scale = 1.0/4294967296.0;
+  for (int c=0; c<n; c++) {
+    uint64_t cell = first+c;
+    uint32_t ctr[4] = {uint32_t(cell), uint32_t(cell >> 32), uint32_t(step), uint32_t(step >> 32)};
+    uint32_t key[2] = {seed, 0};
+    rng::philox(ctr, key);
+    double r_0 = std::sqrt(-2.0*std::log((ctr[0]+0.5)*scale));
+    double r_1 = std::sqrt(-2.0*std::log((ctr[2]+0.5)*scale));
+    CHECK(out[3*c] == r_0*std::cos(2.0*M_PI*(ctr[1]+0.5)*scale));
+    CHECK(out[3*c+1] == r_0*std::sin(2.0*M_PI*(ctr[1]+0.5)*scale));
+    CHECK(out[3*c+2] == r_1*std::cos(2.0*M_PI*(ctr[3]+0.5)*scale));
+  }
+}
+
+// A cell draws the same numbers in any batch
+TEST_CASE("Normals do not depend on the batch", "[random]") {
+  const int n = 2*rng::block+17;
+  std::vector<double> all(3*n), part(3*20);
+  rng::normals(0, n, 42, 7, all.data());
+  rng::normals(rng::block-3, 20, 42, 7, part.data());
+  for (int i=0; i<part.size(); i++) CHECK(part[i] == all[(3*(rng::block-3))+i]);
+}
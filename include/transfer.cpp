@@ -0,0 +1,304 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given 1D system, assumed to be a spin valve/tunnel
+//  junction.
+//
+//  File: transfer.cpp <CODE>
+//
+//  Analytic steady-state solution across a stack of uni-
+//  form material layers.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+// Standard libraries
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+#include "transfer.hpp"
+#include "physics.hpp"
+
+namespace transfer {
+  typedef std::complex<double> cplx;
+
+  // Face coefficients of a mode with diffusion c, inverse decay length k and width L
+  // c_coth = c*k*coth(kL), c_csch = c*k*csch(kL)
+  void mode_stiffness(double c, cplx k, double width, cplx& c_coth, cplx& c_csch) {
+    cplx t = k*width;
+
+    // Series about kL = 0 (no relaxation across the layer)
+    if (std::abs(t) < 1.0e-3) {
+      c_coth = (c/width)*(1.0+(t*t/3.0));
+      c_csch = (c/width)*(1.0-(t*t/6.0));
+    }
+    // Decaying exponentials only, Re(k) > 0
+    else {
+      cplx e = std::exp(-2.0*t);
+      c_coth = c*k*(1.0+e)/(1.0-e);
+      c_csch = c*k*2.0*std::exp(-t)/(1.0-e);
+    }
+  }
+
+  // Mode profile sinh(ks)/sinh(kL) and its derivative k*cosh(ks)/sinh(kL)
+  void mode_profile(cplx k, double width, double s, cplx& f, cplx& df) {
+    cplx t = k*width;
+
+    if (std::abs(t) < 1.0e-3) {
+      f = s/width;
+      df = 1.0/width;
+    }
+    else if (std::abs(t) < 0.5) {
+      f = std::sinh(k*s)/std::sinh(t);
+      df = k*std::cosh(k*s)/std::sinh(t);
+    }
+    else {
+      cplx e = std::exp(k*(s-width))/(1.0-std::exp(-2.0*t));
+      cplx e_s = std::exp(-2.0*k*s);
+      f = e*(1.0-e_s);
+      df = k*e*(1.0+e_s);
+    }
+  }
+
+  // Rotate a block from the magnetization frame to the lab frame, F*B*F^T
+  solver::block_t<double> to_lab(const solver::block_t<double>& frame, const solver::block_t<double>& b) {
+    solver::block_t<double> frame_t;
+    for (int i=0; i<3; i++) {
+      for (int j=0; j<3; j++) frame_t[3*i+j] = frame[3*j+i];
+    }
+    return solver::mul(frame, solver::mul(b, frame_t));
+  }
+
+  // Block acting as c_perp on the transverse pair and c_par on the longitudinal component
+  solver::block_t<double> mode_block(cplx c_perp, cplx c_par) {
+    solver::block_t<double> b = solver::zero<double>();
+    b[0] = c_perp.real(); b[1] = -c_perp.imag();
+    b[3] = c_perp.imag(); b[4] = c_perp.real();
+    b[8] = c_par.real();
+    return b;
+  }
+
+  // Build the modes of a single material
+  layer_t make_layer(const mat::material& material, double lower, double width, double j_e) {
+    layer_t layer;
+    layer.lower = lower;
+    layer.width = width;
+    layer.m_inf = material.scal_prop[0];
+    for (int i=0; i<3; i++) layer.mag[i] = material.mag[i];
+
+    double beta      = material.scal_prop[1];
+    double beta_diff = material.scal_prop[2];
+    double diff      = material.scal_prop[3];
+    double len_j     = material.scal_prop[4];
+    double len_phi   = material.scal_prop[5];
+    double len_sf    = material.scal_prop[6];
+
+    // Magnetization frame, e3 along M
+    double mag_len = std::sqrt(layer.mag[0]*layer.mag[0]+layer.mag[1]*layer.mag[1]+layer.mag[2]*layer.mag[2]);
+    layer.frame = solver::identity<double>();
+    if (mag_len > 0.0) {
+      double e3[3] = {layer.mag[0]/mag_len, layer.mag[1]/mag_len, layer.mag[2]/mag_len};
+      double a[3] = {1.0, 0.0, 0.0};
+      if (std::abs(e3[0]) > 0.9) {a[0] = 0.0; a[1] = 1.0;}
+      double a_e3 = a[0]*e3[0]+a[1]*e3[1]+a[2]*e3[2];
+      double e1[3] = {a[0]-a_e3*e3[0], a[1]-a_e3*e3[1], a[2]-a_e3*e3[2]};
+      double e1_len = std::sqrt(e1[0]*e1[0]+e1[1]*e1[1]+e1[2]*e1[2]);
+      for (int i=0; i<3; i++) e1[i] /= e1_len;
+      double e2[3] = {e3[1]*e1[2]-e3[2]*e1[1], e3[2]*e1[0]-e3[0]*e1[2], e3[0]*e1[1]-e3[1]*e1[0]};
+      for (int i=0; i<3; i++) {
+        layer.frame[3*i]   = e1[i];
+        layer.frame[3*i+1] = e2[i];
+        layer.frame[3*i+2] = e3[i];
+      }
+    }
+
+    // Diffusion coefficients, J_m = B*j_e*M - 2D[dm_dx - B*B'*M(M.dm_dx)]
+    layer.c_perp = 2.0*diff;
+    layer.c_par  = 2.0*diff*(1.0-(beta*beta_diff*mag_len*mag_len));
+
+    // Relaxation: spin flip on all components, precession and dephasing on the transverse pair
+    cplx relax_perp = 1.0/(len_sf*len_sf);
+    if (mag_len > 0.0) {
+      relax_perp += cplx(mag_len*mag_len/(len_phi*len_phi), -mag_len/(len_j*len_j));
+    }
+    layer.k_par  = std::sqrt(1.0/(len_sf*len_sf*layer.c_par));
+    layer.k_perp = std::sqrt(relax_perp/layer.c_perp);
+
+    for (int i=0; i<3; i++) layer.j_p[i] = beta*j_e*layer.mag[i];
+
+    // Stiffness blocks
+    cplx perp_coth, perp_csch, par_coth, par_csch;
+    mode_stiffness(layer.c_perp, layer.k_perp, width, perp_coth, perp_csch);
+    mode_stiffness(layer.c_par, layer.k_par, width, par_coth, par_csch);
+
+    layer.s_ll = to_lab(layer.frame, mode_block(perp_coth, par_coth));
+    layer.s_lr = to_lab(layer.frame, mode_block(-perp_csch, -par_csch));
+    layer.s_rl = to_lab(layer.frame, mode_block(perp_csch, par_csch));
+    layer.s_rr = to_lab(layer.frame, mode_block(-perp_coth, -par_coth));
+
+    return layer;
+  }
+
+  // Zero-thickness interface at the lower boundary of right, J_m = G*(dm_left - dm_right)
+  layer_t make_iface(const mat::material& left, const mat::material& right) {
+    layer_t layer;
+    layer.lower = right.lower_bound;
+    layer.width = 0.0;
+    layer.m_inf = 0.0;
+    layer.mag.fill(0.0);
+    layer.frame = solver::identity<double>();
+    layer.c_par = layer.c_perp = 0.0;
+    layer.k_par = layer.k_perp = 0.0;
+    layer.j_p.fill(0.0);
+
+    solver::block_t<double> g = physics::iface_tensor(left.mag, right.mag, right.iface_g, right.iface_g_mix);
+    layer.s_ll = layer.s_rl = g;
+    layer.s_lr = layer.s_rr = solver::scale(g, -1.0);
+    return layer;
+  }
+
+  // Decaying modes only, coth(kL) = 1
+  solver::block_t<double> lead_dtn(const mat::material& material) {
+    layer_t layer = make_layer(material, 0.0, 1.0, 0.0);
+    return to_lab(layer.frame, mode_block(layer.c_perp*layer.k_perp, layer.c_par*layer.k_par));
+  }
+
+  // Build all layers and solve for dm at their boundaries
+  stack_t::stack_t(const std::vector<mat::material>& materials, double j_e, int bc_left, int bc_right,
+                   const solver::vec_t<double>& dm_left, const solver::vec_t<double>& dm_right) {
+    // Order materials left to right
+    std::vector<int> order(materials.size());
+    for (int i=0; i<order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {return materials[a].lower_bound < materials[b].lower_bound;});
+
+    // Each layer extends to the start of the next
+    // Interface conductances enter as zero-thickness layers
+    for (int i=0; i<order.size(); i++) {
+      const mat::material& material = materials[order[i]];
+      if (i > 0 && material.iface_g > 0.0) {
+        layers.push_back(make_iface(materials[order[i-1]], material));
+      }
+      double upper = (i+1<order.size()) ? materials[order[i+1]].lower_bound : material.upper_bound;
+      layers.push_back(make_layer(material, material.lower_bound, upper-material.lower_bound, j_e));
+    }
+
+    // Periodic: continuity at every face, the last layer is followed by the first
+    if (bc_left == physics::bc_periodic) {
+      const mat::material& first = materials[order.front()];
+      if (first.iface_g > 0.0) layers.insert(layers.begin(), make_iface(materials[order.back()], first));
+
+      int n = layers.size();
+      solver::btd_t<double> a;
+      a.resize(n);
+      a.cyclic = true;
+      dm.assign(n+1, solver::vec_t<double>());
+      for (int i=0; i<n; i++) {
+        const layer_t& left = layers[(i+n-1)%n];
+        const layer_t& right = layers[i];
+        a.lower[i] = left.s_rl;
+        a.diag[i]  = solver::sub(left.s_rr, right.s_ll);
+        a.upper[i] = solver::scale(right.s_lr, -1.0);
+        dm[i] = solver::sub(right.j_p, left.j_p);
+      }
+      solver::cyclic_t<double> cyclic;
+      cyclic.factor(a);
+      cyclic.solve(dm);
+      dm[n] = dm[0];
+      return;
+    }
+
+    // Boundary system: continuity of J_m at every interface
+    int n = layers.size()+1;
+    solver::btd_t<double> a;
+    a.resize(n);
+    dm.assign(n, solver::vec_t<double>());
+    for (int i=0; i<n; i++) dm[i].fill(0.0);
+
+    // Outer faces, J_m = j_p + s*dm from the end layers
+    // Equilibrium: dm = dm_left, dm_right (0 by default)
+    // Zero flux: J_m = 0
+    // Transparent: J_m matches a semi-infinite lead of the end material
+    const layer_t& first = layers.front();
+    const layer_t& last = layers.back();
+    a.diag[0] = solver::identity<double>();
+    a.diag[n-1] = solver::identity<double>();
+    if (bc_left == physics::bc_equilibrium) dm[0] = dm_left;
+    if (bc_right == physics::bc_equilibrium) dm[n-1] = dm_right;
+    if (bc_left == physics::bc_zero_flux) {
+      a.diag[0] = first.s_ll;
+      a.upper[0] = first.s_lr;
+      for (int l=0; l<3; l++) dm[0][l] = -first.j_p[l];
+    }
+    if (bc_left == physics::bc_transparent) {
+      a.diag[0] = solver::add(first.s_ll, lead_dtn(materials[order.front()]));
+      a.upper[0] = first.s_lr;
+    }
+    if (bc_right == physics::bc_zero_flux) {
+      a.lower[n-1] = last.s_rl;
+      a.diag[n-1] = last.s_rr;
+      for (int l=0; l<3; l++) dm[n-1][l] = -last.j_p[l];
+    }
+    if (bc_right == physics::bc_transparent) {
+      a.lower[n-1] = last.s_rl;
+      a.diag[n-1] = solver::sub(last.s_rr, lead_dtn(materials[order.back()]));
+    }
+    for (int i=1; i<n-1; i++) {
+      const layer_t& left = layers[i-1];
+      const layer_t& right = layers[i];
+      a.lower[i] = left.s_rl;
+      a.diag[i]  = solver::sub(left.s_rr, right.s_ll);
+      a.upper[i] = solver::scale(right.s_lr, -1.0);
+      dm[i] = solver::sub(right.j_p, left.j_p);
+    }
+
+    solver::thomas(a, dm);
+  }
+
+  // Spin accumulation and spin current at position x
+  void stack_t::eval(double x, std::vector<double>& m, std::vector<double>& j_m) const {
+    // Find layer containing x
+    int n = 0;
+    while (n+1<layers.size() && x>=layers[n+1].lower) n++;
+    const layer_t& layer = layers[n];
+    double s = std::min(std::max(x-layer.lower, 0.0), layer.width);
+
+    // Boundary values in the magnetization frame
+    double dm_l[3], dm_r[3];
+    for (int i=0; i<3; i++) {
+      dm_l[i] = layer.frame[i]*dm[n][0] + layer.frame[3+i]*dm[n][1] + layer.frame[6+i]*dm[n][2];
+      dm_r[i] = layer.frame[i]*dm[n+1][0] + layer.frame[3+i]*dm[n+1][1] + layer.frame[6+i]*dm[n+1][2];
+    }
+
+    // dm(s) = dm_l*f(L-s) + dm_r*f(s)
+    cplx f_l, df_l, f_r, df_r;
+    mode_profile(layer.k_perp, layer.width, layer.width-s, f_l, df_l);
+    mode_profile(layer.k_perp, layer.width, s, f_r, df_r);
+    cplx w_l(dm_l[0], dm_l[1]), w_r(dm_r[0], dm_r[1]);
+    cplx w = w_l*f_l + w_r*f_r;
+    cplx dw = -w_l*df_l + w_r*df_r;
+
+    mode_profile(layer.k_par, layer.width, layer.width-s, f_l, df_l);
+    mode_profile(layer.k_par, layer.width, s, f_r, df_r);
+    double z = (dm_l[2]*f_l + dm_r[2]*f_r).real();
+    double dz = (-dm_l[2]*df_l + dm_r[2]*df_r).real();
+
+    double loc[3] = {w.real(), w.imag(), z};
+    double j_loc[3] = {-layer.c_perp*dw.real(), -layer.c_perp*dw.imag(), -layer.c_par*dz};
+
+    m.resize(3);
+    j_m.resize(3);
+    for (int i=0; i<3; i++) {
+      m[i] = layer.m_inf*layer.mag[i];
+      j_m[i] = layer.j_p[i];
+      for (int j=0; j<3; j++) {
+        m[i] += layer.frame[3*i+j]*loc[j];
+        j_m[i] += layer.frame[3*i+j]*j_loc[j];
+      }
+    }
+  }
+}
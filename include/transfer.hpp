@@ -0,0 +1,90 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given 1D system, assumed to be a spin valve/tunnel
+//  junction.
+//
+//  File: transfer.hpp <HEADER>
+//
+//  Analytic steady-state solution across a stack of uni-
+//  form material layers.
+//
+//  Inside a layer the steady-state equations have const-
+//  ant coefficients, so dm = m - m_inf*M is a sum of exp-
+//  onentials. In the frame of M the longitudinal compon-
+//  ent decays with a real length set by L_sf, the trans-
+//  verse pair with a complex length set by L_sf, L_j and
+//  L_phi. Each layer's 6x6 propagator for (dm, J_m) is
+//  used in its two-point (stiffness) form, which relates
+//  J_m at both faces to dm at both faces and stays bou-
+//  nded for thick layers. Continuity of dm and J_m at
+//  the interfaces then gives a block-tridiagonal system
+//  over the layer boundaries only. An interface conduct-
+//  ance is a zero-thickness layer with J_m = G*(jump in
+//  dm) at both faces.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+#ifndef TRANSFER_HPP
+#define TRANSFER_HPP
+
+#include <vector>
+#include <complex>
+
+#include "material.hpp"
+#include "solver.hpp"
+
+namespace transfer {
+  // Decay modes and stiffness of a uniform layer
+  struct layer_t {
+    double lower;                      // Left face
+    double width;                      // Thickness
+    double m_inf;                      // Equilibrium spin accumulation
+    solver::vec_t<double> mag;         // Magnetization
+    solver::block_t<double> frame;     // Columns e1, e2, e3 with e3 along M
+    double c_par;                      // Longitudinal diffusion 2D(1-BB'|M|^2)
+    double c_perp;                     // Transverse diffusion 2D
+    std::complex<double> k_par;        // Longitudinal inverse decay length
+    std::complex<double> k_perp;       // Transverse inverse decay length
+    solver::vec_t<double> j_p;         // Source spin current B*j_e*M
+
+    // Diffusive spin current at the faces from dm at the faces
+    // J_left  = s_ll*dm_left + s_lr*dm_right
+    // J_right = s_rl*dm_left + s_rr*dm_right
+    solver::block_t<double> s_ll, s_lr, s_rl, s_rr;
+  };
+
+  // Build the modes of a single material
+  layer_t make_layer(const mat::material& material, double lower, double width, double j_e);
+
+  // Zero-thickness interface at the lower boundary of right
+  layer_t make_iface(const mat::material& left, const mat::material& right);
+
+  // Dirichlet-to-Neumann map of a semi-infinite lead of the material
+  // J_m = B*j_e*M + lead*dm at a face with the lead to its right, - on its left
+  solver::block_t<double> lead_dtn(const mat::material& material);
+
+  class stack_t {
+  public:
+    // Outer faces as physics::bc_equilibrium, bc_zero_flux, bc_transparent or
+    // bc_periodic (both ends), equilibrium faces hold dm_left and dm_right
+    stack_t(const std::vector<mat::material>& materials, double j_e, int bc_left = 0, int bc_right = 0,
+            const solver::vec_t<double>& dm_left = solver::vec_t<double>(),
+            const solver::vec_t<double>& dm_right = solver::vec_t<double>());
+
+    // Spin accumulation and spin current at position x
+    void eval(double x, std::vector<double>& m, std::vector<double>& j_m) const;
+
+  private:
+    std::vector<layer_t> layers;
+
+    // dm at the layer boundaries
+    std::vector<solver::vec_t<double> > dm;
+  };
+}
+
+#endif /* TRANSFER_HPP */
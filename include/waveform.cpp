@@ -0,0 +1,91 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: waveform.cpp <CODE>
+//
+//  Charge current density against time.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+// Standard libraries
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "waveform.hpp"
+
+namespace wave {
+  waveform_t::waveform_t() : kind("ramp"), amplitude(0.0), t_ramp(0.0) {}
+
+  waveform_t::waveform_t(const std::string& kind,
+                         double amplitude,
+                         const std::vector<double>& args,
+                         double t_ramp,
+                         const std::vector<double>& t_tab,
+                         const std::vector<double>& j_tab)
+    : kind(kind), amplitude(amplitude), args(args), t_ramp(t_ramp), t_tab(t_tab), j_tab(j_tab) {
+    if (kind == "ramp" && t_ramp > 0.0) edges.push_back(t_ramp);
+    if (kind == "pulse" || kind == "train") {
+      double rise = args[(kind == "pulse") ? 2 : 4];
+      int count = (kind == "pulse") ? 1 : int(args[3]);
+      double period = (kind == "pulse") ? 0.0 : args[2];
+      for (int k=0; k<count; k++) {
+        double t_0 = args[0]+(k*period);
+        edges.push_back(t_0);
+        edges.push_back(t_0+rise);
+        edges.push_back(t_0+args[1]);
+        edges.push_back(t_0+args[1]+rise);
+      }
+    }
+    if (kind == "table") edges = t_tab;
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  }
+
+  // Trapezoid of unit height, s from the start of the rise
+  double waveform_t::pulse(double s, double width, double rise) const {
+    if (s < 0.0) return 0.0;
+    if (s < rise) return s/rise;
+    if (s < width) return 1.0;
+    if (s < width+rise) return 1.0-((s-width)/rise);
+    return 0.0;
+  }
+
+  double waveform_t::value(double t) const {
+    if (kind == "pulse") return amplitude*pulse(t-args[0], args[1], args[2]);
+    if (kind == "train") {
+      // Pulse k covers [t_start + k*period, t_start + k*period + width + rise)
+      double s = t-args[0];
+      if (s < 0.0) return 0.0;
+      int k = std::min(int(floor(s/args[2])), int(args[3])-1);
+      return amplitude*pulse(s-(k*args[2]), args[1], args[4]);
+    }
+    if (kind == "sine") return args[2]+(amplitude*sin((2.0*M_PI*args[0]*t)+args[1]));
+    if (kind == "table") {
+      if (t < t_tab.front()) return j_tab.front();
+      int k = std::upper_bound(t_tab.begin(), t_tab.end(), t)-t_tab.begin();
+      if (k == t_tab.size()) return j_tab.back();
+      double w = (t-t_tab[k-1])/(t_tab[k]-t_tab[k-1]);
+      return ((1.0-w)*j_tab[k-1])+(w*j_tab[k]);
+    }
+
+    // Ramp
+    if (t < t_ramp) return amplitude*t/t_ramp;
+    return amplitude;
+  }
+
+  double waveform_t::next_edge(double t) const {
+    std::vector<double>::const_iterator e = std::upper_bound(edges.begin(), edges.end(), t);
+    if (e == edges.end()) return std::numeric_limits<double>::infinity();
+    return *e;
+  }
+}
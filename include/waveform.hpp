@@ -0,0 +1,72 @@
+// =======================================================
+//  Dynamic Spin Accumulation Calculation
+//
+//  Author: Luke Elliott
+//
+//  Test code for simulating the spin accumulation across
+//  a given system, assumed to be a spin valve/tunnel ju-
+//  nction.
+//
+//  File: waveform.hpp <HEADER>
+//
+//  Charge current density against time for the evolve
+//  modes.
+//
+//  Kinds, amplitude j_e:
+//
+//    ramp   j_e*t/t_ramp up to t_ramp, j_e after
+//    pulse  [t_start, width, rise], trapezoid rising from
+//           t_start over rise, falling from t_start+width
+//           over rise (rise 0: a step on [t_start,
+//           t_start+width))
+//    train  [t_start, width, period, count, rise], count
+//           pulses period apart
+//    sine   [frequency, phase, offset], offset+j_e*sin(
+//           2*pi*frequency*t+phase)
+//    table  pairs t, j read from file, linear between the
+//           points, a repeated t is a jump
+//
+//  Values are continuous from the right. Edges are the
+//  times where the current or its slope jumps, adaptive
+//  steps are ended on them.
+//
+//  GNU GPLv3. See LICENSE for details.
+// =======================================================
+
+#ifndef WAVEFORM_HPP
+#define WAVEFORM_HPP
+
+#include <vector>
+#include <string>
+
+namespace wave {
+  class waveform_t {
+  public:
+    waveform_t();
+
+    // args as above, t_ramp for the ramp, the points of a table in t_tab, j_tab
+    waveform_t(const std::string& kind,
+               double amplitude,
+               const std::vector<double>& args,
+               double t_ramp,
+               const std::vector<double>& t_tab = std::vector<double>(),
+               const std::vector<double>& j_tab = std::vector<double>());
+
+    double value(double t) const;
+
+    // First edge after t (infinity if none)
+    double next_edge(double t) const;
+
+  private:
+    double pulse(double s, double width, double rise) const;
+
+    std::string kind;
+    double amplitude;
+    std::vector<double> args;
+    double t_ramp;
+    std::vector<double> t_tab, j_tab;
+    std::vector<double> edges;        // Sorted
+  };
+}
+
+#endif /* WAVEFORM_HPP */
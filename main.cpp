@@ -18,7 +18,9 @@
 // Standard headers
 #include <iostream>
 
-// Unit testing
+// Unit testing, the session is run by the test mode
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
 #include "catch.hpp"
 
 // Personal modules
@@ -46,9 +48,12 @@ int main(int argc, char *argv[]) {
       break;
     }
 
-  // Test mode
+  // Test mode, arguments after -t go to Catch
   case 1:
-    break;
+    {
+      argv[1] = argv[0];
+      return Catch::Session().run(argc-1, argv+1);
+    }
   }
 
   // System initialization
@@ -60,7 +65,7 @@ int main(int argc, char *argv[]) {
   sys::system.iface_init();
   sys::system.system_out();
 
-  sys::system.evolve();
+  sys::system.run();
 
 
 